@@ -4,106 +4,65 @@
 
 #pragma once
 
-#include "sparse_matrix.hpp"
+#include "commons.hpp"
 
 namespace stn {
 
-    // Note: We could even make the rep generic in the underlying Const representation
-    //       But I cannot imagine that anything else than vector<vector<index_t>> would
-    //       make sense
-    template<typename PivotColumn>
-    class AbstractPivotColumn : public SparseMatrix {
-
-    protected:
-        using Base = SparseMatrix;
-
-        // For parallization purposes, it could be more than one full column
-        mutable thread_local_storage< PivotColumn > pivot_cols;
-        mutable thread_local_storage< index_t > idx_of_pivot_cols;
-
-        PivotColumn& get_pivot_col() const {
-            return pivot_cols();
-        }
-
-        bool is_pivot_col( index_t idx ) const {
-            return idx_of_pivot_cols() == idx;
-        }
-
-        void release_pivot_col() {
-            index_t idx = idx_of_pivot_cols();
-            if( idx != -1 ) {
-                this->matrix[ idx ].clear();
-                pivot_cols().get_col_and_clear( this->matrix[ idx ] );
-            }
-            idx_of_pivot_cols() = -1;
-        }
-
-        void make_pivot_col( index_t idx ) {
-            release_pivot_col();
-            idx_of_pivot_cols() = idx;
-            get_pivot_col().add_col( matrix[ idx ] );
-        }
-
-    public:
-        void _set_num_cols( index_t nr_of_cols ) {
-            #pragma omp parallel for
-            for( int tid = 0; tid < omp_get_num_threads(); tid++ ) {
-                pivot_cols[ tid ].init( nr_of_cols );
-                idx_of_pivot_cols[ tid ] = -1;
-            }
-            Base::_set_num_cols( nr_of_cols );
-        }
-
-        void _add( index_t source, index_t target ) {
-            if( !is_pivot_col( target ) )
-                make_pivot_col( target );
-            get_pivot_col().add_col( matrix[source] );
-        }
-
-        void _add( column& source_col, index_t target ) {
-            if( !is_pivot_col( target ) )
-                make_pivot_col( target );
-            get_pivot_col().add_col( source_col );
-        }
-
-
-        void _sync() {
-            #pragma omp parallel for
-            for( int tid = 0; tid < omp_get_num_threads(); tid++ )
-                release_pivot_col();
-        }
-
-        void _get_col( index_t idx, column& col  ) const {
-          is_pivot_col( idx ) ? get_pivot_col().get_col( col ) :
-            Base::_get_col( idx, col );
-        }
-
-        bool _is_empty( index_t idx ) const {
-          return is_pivot_col( idx ) ? get_pivot_col().is_empty() :
-            Base::_is_empty( idx );
-        }
-
-        index_t _get_max_index( index_t idx ) const {
-          return is_pivot_col( idx ) ? get_pivot_col().get_max_index()
-            : Base::_get_max_index( idx );
-        }
-
-        void _clear( index_t idx ) {
-          is_pivot_col( idx ) ? get_pivot_col().clear() :
-            Base::_clear( idx );
-        }
-
-        void _set_col( index_t idx, const column& col  ) {
-          is_pivot_col( idx ) ? get_pivot_col().set_col( col ) :
-            Base::_set_col( idx, col );
-        }
-
-        void _remove_max( index_t idx ) {
-          is_pivot_col( idx ) ? get_pivot_col().remove_max() :
-            Base::_remove_max( idx );
-        }
-
-        void finalize( index_t idx ) { Base::_finalize( idx ); }
-    };
+  // Working column of a reduction. The column being reduced is loaded into
+  // it, the pivot columns are added to it until its pivot is new, and it is
+  // then written back to the matrix. Each strategy keeps the column in a
+  // structure that makes these additions cheaper than merging sorted
+  // columns when they fill in.
+  //
+  // Derived classes provide init(n_rows), add_index(row), which flips a
+  // row, get_max_index() and is_empty(). The rest is built on those and
+  // may be overridden where a strategy can do better.
+  template<typename Derived>
+  class AbstractPivotColumn {
+  private:
+    Derived& derived() {
+      return static_cast<Derived&>(*this);
+    }
+
+  public:
+    template<typename Column>
+    void add_col(const Column& col) {
+      for(typename Column::const_iterator row = col.begin(); row != col.end(); ++row)
+        derived().add_index(*row);
+    }
+
+    // Removes the largest row and returns it, or -1 when empty
+    index_t pop_max_index() {
+      const index_t max_index = derived().get_max_index();
+      if(max_index != -1)
+        derived().add_index(max_index);
+      return max_index;
+    }
+
+    void remove_max() {
+      derived().pop_max_index();
+    }
+
+    // Writes the rows to col in increasing order and leaves this empty
+    template<typename Column>
+    void get_col_and_clear(Column& col) {
+      col.clear();
+      for(index_t row = derived().pop_max_index(); row != -1;
+          row = derived().pop_max_index())
+        col.push_back(row);
+      std::reverse(col.begin(), col.end());
+    }
+
+    void clear() {
+      while(derived().pop_max_index() != -1);
+    }
+
+    template<typename Column>
+    void set_col(const Column& col) {
+      derived().clear();
+      derived().add_col(col);
+    }
+
+  };
 
 } // namespace stn
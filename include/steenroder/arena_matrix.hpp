@@ -0,0 +1,361 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include <numeric>
+
+#include "commons.hpp"
+#include "column_span.hpp"
+#include "sparse_matrix.hpp"
+#include "symmetric_difference.hpp"
+#include "vector_column.hpp"
+
+namespace stn {
+
+  // Column type selecting the arena storage of SparseMatrix. Columns are still
+  // handed in and out as VectorColumn, so that ViewMatrix, AttributeMatrix,
+  // the bars and the reductions work unchanged with ArenaColumn.
+  class ArenaColumn : public VectorColumn {
+  public:
+    ArenaColumn()
+      : VectorColumn()
+    {}
+
+    ArenaColumn(const size_t n_rows, const index_t value)
+      : VectorColumn(n_rows, value)
+    {}
+
+    ArenaColumn(const VectorColumn& col)
+      : VectorColumn(col)
+    {}
+
+    ArenaColumn(VectorColumn&& col)
+      : VectorColumn(std::move(col))
+    {}
+
+  };
+
+
+  // Writing a column may reallocate the pool of all of them, see below
+  template<>
+  struct ConcurrentColumnWrites<ArenaColumn> {
+    enum { value = false };
+  };
+
+  // Stores all columns in a single pool of row indices. Each column owns a
+  // slot [offset, offset + capacity) of the pool, of which the first length
+  // entries are used. A column that outgrows its slot is moved to the end of
+  // the pool with some slack, where it can keep growing in place while it
+  // stays last. Abandoned slots are reclaimed by repacking the pool once they
+  // make up more than half of it.
+  template<>
+  class SparseMatrix<ArenaColumn> {
+  public:
+    using column_index_t = index_t;
+
+  private:
+    struct Slot {
+      index_t offset;
+      index_t length;
+      index_t capacity;
+    };
+
+    static const index_t min_compaction_size = 1 << 16;
+
+    std::vector<index_t> pool;
+    std::vector<Slot> slots;
+    index_t n_garbage;
+    thread_local_storage<VectorColumn> temp_column_buffer;
+
+    index_t* column_data(const index_t idx) {
+      return pool.data() + slots[idx].offset;
+    }
+
+    // Makes room for n_rows entries in the slot of column idx, keeping the
+    // entries already there when it has to move
+    void reserve(const index_t idx, const index_t n_rows) {
+      Slot& slot = slots[idx];
+      if(n_rows <= slot.capacity)
+        return;
+
+      if(slot.offset + slot.capacity == (index_t) pool.size()) {
+        pool.resize(slot.offset + n_rows + n_rows / 2);
+      } else {
+        const index_t offset = pool.size();
+        pool.resize(offset + n_rows + n_rows / 2);
+        std::copy(pool.begin() + slot.offset, pool.begin() + slot.offset + slot.length,
+                  pool.begin() + offset);
+        n_garbage += slot.capacity;
+        slot.offset = offset;
+      }
+      slot.capacity = pool.size() - slot.offset;
+    }
+
+    void write_column(const index_t idx, const index_t* begin, const index_t* end) {
+      const index_t n_rows = end - begin;
+      if(n_rows > slots[idx].capacity) {
+        slots[idx].length = 0;
+        reserve(idx, n_rows);
+      }
+      std::copy(begin, end, column_data(idx));
+      slots[idx].length = n_rows;
+      compact_if_sparse();
+    }
+
+    void compact_if_sparse() {
+      if((index_t) pool.size() > min_compaction_size
+         && n_garbage > (index_t) pool.size() / 2)
+        compact();
+    }
+
+  protected:
+    // Same as for the other column types, except that entries live in the
+    // pool and are copied. A column swapped out for an empty one gives up
+    // its slot.
+    void swap_column(const index_t idx, ArenaColumn& col) {
+      ArenaColumn stored;
+      get_column(idx, stored);
+      if(col.empty()) {
+        n_garbage += slots[idx].capacity;
+        slots[idx] = Slot{0, 0, 0};
+        compact_if_sparse();
+      } else {
+        set_column(idx, col);
+      }
+      col.swap(stored);
+    }
+
+    template<typename> friend class MatrixVector;
+
+  public:
+    SparseMatrix()
+      : pool()
+      , slots()
+      , n_garbage(0)
+    {}
+
+    SparseMatrix(const index_t n_columns_in)
+      : pool()
+      , slots(n_columns_in, Slot{0, 0, 0})
+      , n_garbage(0)
+    {}
+
+    SparseMatrix(const SparseMatrix& other)
+      : pool(other.pool)
+      , slots(other.slots)
+      , n_garbage(other.n_garbage)
+    {}
+
+    SparseMatrix(SparseMatrix&& other)
+      : pool(std::move(other.pool))
+      , slots(std::move(other.slots))
+      , n_garbage(other.n_garbage)
+    {
+      other.n_garbage = 0;
+    }
+
+    SparseMatrix& operator=(const SparseMatrix& other) {
+      pool = other.pool;
+      slots = other.slots;
+      n_garbage = other.n_garbage;
+      return *this;
+    }
+
+    SparseMatrix& operator=(SparseMatrix&& other) {
+      pool = std::move(other.pool);
+      slots = std::move(other.slots);
+      n_garbage = other.n_garbage;
+      other.n_garbage = 0;
+      return *this;
+    }
+
+    index_t get_n_columns() const {
+      return (index_t) slots.size();
+    }
+
+    void set_n_columns(const index_t n_columns) {
+      for(index_t idx = n_columns; idx < get_n_columns(); ++idx)
+        n_garbage += slots[idx].capacity;
+      slots.resize(n_columns, Slot{(index_t) pool.size(), 0, 0});
+      compact_if_sparse();
+    }
+
+    // Makes this the n_columns identity matrix, packed in a single block
+    void set_identity(const index_t n_columns) {
+      pool.resize(n_columns);
+      std::iota(pool.begin(), pool.end(), 0);
+      slots.resize(n_columns);
+      for(index_t idx = 0; idx < n_columns; ++idx)
+        slots[idx] = Slot{idx, 1, 1};
+      n_garbage = 0;
+    }
+
+    void set_identity(const std::vector<column_index_t>& rows) {
+      pool = rows;
+      slots.resize(rows.size());
+      for(index_t idx = 0; idx < (index_t) rows.size(); ++idx)
+        slots[idx] = Slot{idx, 1, 1};
+      n_garbage = 0;
+    }
+
+    void get_column(const index_t idx, VectorColumn& col) const {
+      col.assign(column_begin(idx), column_end(idx));
+    }
+
+    void set_column(const index_t idx, const VectorColumn& col) {
+      write_column(idx, col.data(), col.data() + col.size());
+    }
+
+    // Packs the given columns into a new pool; they are left empty
+    void load_columns(std::vector<ArenaColumn>& columns) {
+      const index_t n_columns = (index_t) columns.size();
+      slots.resize(n_columns);
+      index_t n_entries = 0;
+      for(index_t idx = 0; idx < n_columns; ++idx) {
+        slots[idx] = Slot{n_entries, (index_t) columns[idx].size(),
+                          (index_t) columns[idx].size()};
+        n_entries += columns[idx].size();
+      }
+
+      pool.resize(n_entries);
+      #pragma omp parallel for schedule(dynamic, 1024)
+      for(index_t idx = 0; idx < n_columns; ++idx)
+        std::copy(columns[idx].begin(), columns[idx].end(), column_data(idx));
+      n_garbage = 0;
+      std::vector<ArenaColumn>().swap(columns);
+    }
+
+    // Moves every column to the front of the pool, dropping abandoned slots
+    // and the slack of the others
+    void compact() {
+      std::vector<index_t> packed_pool(pool.size() - n_garbage);
+      index_t offset = 0;
+      for(Slot& slot : slots) {
+        std::copy(pool.begin() + slot.offset, pool.begin() + slot.offset + slot.length,
+                  packed_pool.begin() + offset);
+        slot.offset = offset;
+        slot.capacity = slot.length;
+        offset += slot.length;
+      }
+      packed_pool.resize(offset);
+      pool.swap(packed_pool);
+      n_garbage = 0;
+    }
+
+    // Entries of a column, valid until the matrix is next modified
+    const index_t* column_begin(const index_t idx) const {
+      return pool.data() + slots[idx].offset;
+    }
+
+    const index_t* column_end(const index_t idx) const {
+      return pool.data() + slots[idx].offset + slots[idx].length;
+    }
+
+    ColumnSpan<index_t> get_span(const index_t idx) const {
+      return ColumnSpan<index_t>(column_begin(idx), column_end(idx));
+    }
+
+    bool is_empty(const index_t idx) const {
+      return slots[idx].length == 0;
+    }
+
+    index_t get_max_index(const index_t idx) const {
+      return slots[idx].length == 0 ? -1 : *(column_end(idx) - 1);
+    }
+
+    void remove_max(const index_t idx) {
+      --slots[idx].length;
+    }
+
+    void clear(const index_t idx) {
+      slots[idx].length = 0;
+    }
+
+    void swap(const index_t idx_1, const index_t idx_2) {
+      std::swap(slots[idx_1], slots[idx_2]);
+    }
+
+    void erase(const index_t idx) {
+      n_garbage += slots[idx].capacity;
+      slots.erase(slots.begin() + idx);
+      compact_if_sparse();
+    }
+
+    void append(const VectorColumn& col) {
+      slots.push_back(Slot{(index_t) pool.size(), 0, 0});
+      set_column(get_n_columns() - 1, col);
+    }
+
+    void add(const index_t source, const index_t target) {
+      VectorColumn& temp_col = temp_column_buffer();
+
+      size_t new_size = slots[source].length + slots[target].length;
+      if(new_size > temp_col.size()) {
+        temp_col.resize(new_size);
+      }
+
+      const index_t* col_end =
+        symmetric_difference(column_begin(target), column_end(target),
+                             column_begin(source), column_end(source),
+                             temp_col.data());
+
+      write_column(target, temp_col.data(), col_end);
+    }
+
+    void add(const ColumnSpan<index_t>& source_col, const index_t target) {
+      VectorColumn& temp_col = temp_column_buffer();
+
+      size_t new_size = source_col.size() + slots[target].length;
+      if(new_size > temp_col.size()) {
+        temp_col.resize(new_size);
+      }
+
+      const index_t* col_end =
+        symmetric_difference(column_begin(target), column_end(target),
+                             source_col.begin(), source_col.end(),
+                             temp_col.data());
+
+      write_column(target, temp_col.data(), col_end);
+    }
+
+    void add(const VectorColumn& source_col, const index_t target) {
+      add(make_span(source_col), target);
+    }
+
+    index_t get_n_rows(const index_t idx) const {
+      return slots[idx].length;
+    }
+
+    index_t get_max_column_entries() const {
+      index_t max_column_entries = -1;
+      for(const Slot& slot : slots)
+        max_column_entries = std::max(max_column_entries, slot.length);
+      return max_column_entries;
+    }
+
+    index_t get_max_row_entries() const {
+      const index_t n_columns = get_n_columns();
+      std::vector<index_t> row_entries(n_columns, 0);
+      for(index_t idx = 0; idx < n_columns; ++idx) {
+        for(const index_t* row = column_begin(idx); row != column_end(idx); ++row)
+          ++row_entries[*row];
+      }
+
+      index_t max_row_entries = 0;
+      for(index_t n_row_entries : row_entries)
+        max_row_entries = std::max(max_row_entries, n_row_entries);
+      return max_row_entries;
+    }
+
+    index_t get_n_entries() const {
+      index_t n_nonzero_entries = 0;
+      for(const Slot& slot : slots)
+        n_nonzero_entries += slot.length;
+      return n_nonzero_entries;
+    }
+
+  };
+
+} // namespace stn
@@ -23,6 +23,18 @@ namespace stn {
       opt->addUsage(" -d  --dim <dim>                Dimension. Default: 1 ");
       opt->addUsage(" -k  --k <k>                    k. Default: 1 ");
       opt->addUsage(" -r  --reps                     Outputs representatives ");
+      opt->addUsage(" -b  --binary                   Binary input and output ");
+      opt->addUsage(" -z  --compress                 Compressed binary output ");
+      opt->addUsage(" -f  --freeze                   Keeps the reduced matrices compressed in memory ");
+      opt->addUsage("                                while the Steenrod squares are computed ");
+      opt->addUsage(" -t  --threads <n>              Number of threads. Default: all ");
+      opt->addUsage(" -m  --memory <MB>              Memory budget of the out-of-core dualize. ");
+      opt->addUsage("                                Default: 0, dualize in memory ");
+      opt->addUsage(" -w  --write <names>            Intermediate matrices to write, comma separated ");
+      opt->addUsage("                                among boundary, simplex, dual_boundary, dual_finite, ");
+      opt->addUsage("                                dual_infinite and steenrod, or all or none. Default: all ");
+      opt->addUsage("                                Dual matrices and pairs only cover the dimensions ");
+      opt->addUsage("                                the Steenrod squares need. ");
       opt->addUsage("");
     }
 
@@ -31,6 +43,12 @@ namespace stn {
       opt->setOption("dim", 'd');
       opt->setOption("k", 'k');
       opt->setFlag("reps", 'r');
+      opt->setFlag("binary", 'b');
+      opt->setFlag("compress", 'z');
+      opt->setFlag("freeze", 'f');
+      opt->setOption("threads", 't');
+      opt->setOption("memory", 'm');
+      opt->setOption("write", 'w');
     }
 
     AnyOption* initOption(int &argc, char **argv) {
@@ -61,6 +79,12 @@ namespace stn {
     const unsigned int dim;
     const unsigned int k;
     const bool reps;
+    const bool binary;
+    const bool compress;
+    const bool freeze;
+    const unsigned int threads;
+    const unsigned int memory;
+    const std::string dumps;
     const std::string input_filename;
     const std::string output_filename;
 
@@ -70,6 +94,12 @@ namespace stn {
       , dim(atoi(getValue('d', "1")))
       , k(atoi(getValue('k', "1")))
       , reps(option->getFlag('r'))
+      , binary(option->getFlag('b'))
+      , compress(option->getFlag('z'))
+      , freeze(option->getFlag('f'))
+      , threads(atoi(getValue('t', "0")))
+      , memory(atoi(getValue('m', "0")))
+      , dumps(getValue('w', "all"))
       , input_filename(getFilename(option->getArgv(0)))
       , output_filename(getFilename(option->getArgv(1)))
     {}
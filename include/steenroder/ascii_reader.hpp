@@ -0,0 +1,326 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstring>
+
+#include "commons.hpp"
+#include "mapped_file.hpp"
+
+namespace stn {
+
+  // Timing of a single file parse
+  struct ParseStatistics {
+    size_t n_bytes;
+    double seconds;
+
+    ParseStatistics()
+      : n_bytes(0)
+      , seconds(0.)
+    {}
+
+    double get_throughput() const {
+      return seconds > 0. ? (double) n_bytes / (1024. * 1024.) / seconds : 0.;
+    }
+  };
+
+  inline std::ostream& operator<<(std::ostream& os, const ParseStatistics& stats) {
+    os << "Parsed " << std::fixed << std::setprecision(2)
+       << (double) stats.n_bytes / (1024. * 1024.) << " MB in "
+       << stats.seconds << " s (" << stats.get_throughput() << " MB/s)";
+    return os;
+  }
+
+
+  // Single pass scanner over a byte range of a PHAT ascii file.
+  // Format: each line represents a column, first number is attribute, other
+  // numbers are the content of the column. Blank lines and lines starting
+  // with '#' are skipped.
+  class AsciiScanner {
+  private:
+    const char* position;
+    const char* end;
+    bool failed;
+
+    static bool is_blank(const char c) {
+      return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+    }
+
+    static bool is_digit(const char c) {
+      return c >= '0' && c <= '9';
+    }
+
+    void skip_blanks() {
+      while(position != end && is_blank(*position))
+        ++position;
+    }
+
+    void skip_line() {
+      const char* newline = (const char*) memchr(position, '\n', end - position);
+      position = newline ? newline + 1 : end;
+    }
+
+    // Dimensions and rows are never negative, so neither is accepted
+    bool parse_index(index_t& value) {
+      if(!is_digit(*position)) {
+        failed = true;
+        return false;
+      }
+
+      index_t result = 0;
+      do {
+        result = result * 10 + (*position - '0');
+        ++position;
+      } while(position != end && is_digit(*position));
+
+      value = result;
+      return true;
+    }
+
+  public:
+    AsciiScanner(const char* begin_in, const char* end_in)
+      : position(begin_in)
+      , end(end_in)
+      , failed(false)
+    {}
+
+    bool fail() const {
+      return failed;
+    }
+
+    // Parses the next column into col, keeping it sorted. Returns false once
+    // the end of the range is reached or on malformed input.
+    template<typename ColumnType>
+    bool next_column(index_t& attribute, ColumnType& col) {
+      while(!failed) {
+        skip_blanks();
+        if(position == end)
+          return false;
+
+        if(*position == '\n') {
+          ++position;
+          continue;
+        }
+        if(*position == '#') {
+          skip_line();
+          continue;
+        }
+
+        if(!parse_index(attribute))
+          return false;
+
+        col.clear();
+        bool sorted = true;
+        index_t idx_row;
+        while(true) {
+          skip_blanks();
+          if(position == end || *position == '\n')
+            break;
+          if(!parse_index(idx_row))
+            return false;
+          sorted = sorted && (col.empty() || col.back() < idx_row);
+          col.push_back(idx_row);
+        }
+
+        if(!sorted)
+          std::sort(col.begin(), col.end());
+        return true;
+      }
+      return false;
+    }
+
+    // Parses all remaining columns, appending them to columns and their
+    // attributes to attributes.
+    template<typename ColumnType, typename AttributeType>
+    bool read_columns(std::vector<ColumnType>& columns,
+                      std::vector<AttributeType>& attributes) {
+      index_t attribute;
+      ColumnType col;
+      while(next_column(attribute, col)) {
+        attributes.push_back((AttributeType) attribute);
+        columns.push_back(std::move(col));
+        col = ColumnType();
+      }
+      return !failed;
+    }
+
+  };
+
+
+  // Reads a whole PHAT ascii file. Files of at least parallel_threshold
+  // bytes are split into newline aligned chunks parsed by all OpenMP
+  // threads; the result is identical to the serial scan.
+  class AsciiReader {
+  private:
+    MappedFile file;
+    AsciiScanner scanner;
+    bool failed;
+    std::chrono::steady_clock::time_point start_time;
+
+    static const size_t parallel_threshold = 1 << 24;
+
+    // Counts the entries of each row of already parsed columns
+    template<typename ColumnType>
+    static void count_rows(const std::vector<ColumnType>& columns,
+                           std::vector<index_t>& row_counts) {
+      const index_t n_columns = (index_t) columns.size();
+      index_t max_row = -1;
+      #pragma omp parallel for reduction(max: max_row)
+      for(index_t idx_col = 0; idx_col < n_columns; ++idx_col) {
+        if(!columns[idx_col].empty())
+          max_row = std::max(max_row, (index_t) columns[idx_col].back());
+      }
+      if(max_row >= (index_t) row_counts.size())
+        row_counts.resize(max_row + 1, 0);
+
+      #pragma omp parallel for schedule(dynamic, 4096)
+      for(index_t idx_col = 0; idx_col < n_columns; ++idx_col) {
+        for(index_t idx_row : columns[idx_col]) {
+          #pragma omp atomic
+          ++row_counts[idx_row];
+        }
+      }
+    }
+
+  public:
+    AsciiReader()
+      : file()
+      , scanner(nullptr, nullptr)
+      , failed(false)
+      , start_time()
+    {}
+
+    bool open(const std::string& filename) {
+      start_time = std::chrono::steady_clock::now();
+      failed = !file.open(filename);
+      scanner = AsciiScanner(file.begin(), file.end());
+      return !failed;
+    }
+
+    bool fail() const {
+      return failed || scanner.fail();
+    }
+
+    size_t get_n_bytes() const {
+      return file.get_size();
+    }
+
+    template<typename ColumnType>
+    bool next_column(index_t& attribute, ColumnType& col) {
+      return !failed && scanner.next_column(attribute, col);
+    }
+
+    // Parses the whole file with n_chunks chunks. Each chunk starts on a
+    // line boundary and is parsed into its own columns, which are then
+    // moved to their global position given by a prefix sum of chunk sizes.
+    template<typename ColumnType, typename AttributeType>
+    bool read_columns_parallel(std::vector<ColumnType>& columns,
+                               std::vector<AttributeType>& attributes,
+                               const index_t n_chunks) {
+      if(failed)
+        return false;
+
+      const char* begin = file.begin();
+      const size_t n_bytes = file.get_size();
+      std::vector<const char*> boundaries(n_chunks + 1, file.end());
+      boundaries[0] = begin;
+      for(index_t chunk = 1; chunk < n_chunks; ++chunk) {
+        const char* boundary = std::max(begin + n_bytes / n_chunks * chunk,
+                                        boundaries[chunk - 1]);
+        if(boundary != begin && boundary != file.end() && boundary[-1] != '\n') {
+          const char* newline = (const char*) memchr(boundary, '\n',
+                                                     file.end() - boundary);
+          boundary = newline ? newline + 1 : file.end();
+        }
+        boundaries[chunk] = boundary;
+      }
+
+      std::vector<std::vector<ColumnType>> chunk_columns(n_chunks);
+      std::vector<std::vector<AttributeType>> chunk_attributes(n_chunks);
+      bool valid = true;
+      #pragma omp parallel for schedule(dynamic) reduction(&&: valid)
+      for(index_t chunk = 0; chunk < n_chunks; ++chunk) {
+        AsciiScanner chunk_scanner(boundaries[chunk], boundaries[chunk + 1]);
+        if(!chunk_scanner.read_columns(chunk_columns[chunk], chunk_attributes[chunk]))
+          valid = false;
+      }
+      if(!valid) {
+        failed = true;
+        return false;
+      }
+
+      std::vector<index_t> offsets(n_chunks + 1, (index_t) columns.size());
+      for(index_t chunk = 0; chunk < n_chunks; ++chunk)
+        offsets[chunk + 1] = offsets[chunk] + (index_t) chunk_columns[chunk].size();
+      columns.resize(offsets[n_chunks]);
+      attributes.resize(offsets[n_chunks]);
+
+      #pragma omp parallel for schedule(dynamic)
+      for(index_t chunk = 0; chunk < n_chunks; ++chunk) {
+        for(index_t idx = 0; idx < (index_t) chunk_columns[chunk].size(); ++idx) {
+          columns[offsets[chunk] + idx] = std::move(chunk_columns[chunk][idx]);
+          attributes[offsets[chunk] + idx] = chunk_attributes[chunk][idx];
+        }
+        std::vector<ColumnType>().swap(chunk_columns[chunk]);
+      }
+
+      scanner = AsciiScanner(file.end(), file.end());
+      return true;
+    }
+
+    // Parses all remaining columns, appending them to columns and their
+    // attributes to attributes.
+    template<typename ColumnType, typename AttributeType>
+    bool read_columns(std::vector<ColumnType>& columns,
+                      std::vector<AttributeType>& attributes) {
+      if(failed)
+        return false;
+      if(omp_get_max_threads() > 1 && file.get_size() >= parallel_threshold)
+        return read_columns_parallel(columns, attributes,
+                                     (index_t) omp_get_max_threads() * 4);
+      return scanner.read_columns(columns, attributes);
+    }
+
+    // Same as above, additionally counting the entries of each row so that
+    // the anti-transpose can be allocated without a second pass.
+    template<typename ColumnType, typename AttributeType>
+    bool read_columns(std::vector<ColumnType>& columns,
+                      std::vector<AttributeType>& attributes,
+                      std::vector<index_t>& row_counts) {
+      if(failed)
+        return false;
+      if(omp_get_max_threads() > 1 && file.get_size() >= parallel_threshold) {
+        if(!read_columns_parallel(columns, attributes,
+                                  (index_t) omp_get_max_threads() * 4))
+          return false;
+        count_rows(columns, row_counts);
+        return true;
+      }
+
+      index_t attribute;
+      ColumnType col;
+      while(scanner.next_column(attribute, col)) {
+        if(!col.empty() && col.back() >= (index_t) row_counts.size())
+          row_counts.resize(col.back() + 1, 0);
+        for(index_t idx_row : col)
+          ++row_counts[idx_row];
+
+        attributes.push_back((AttributeType) attribute);
+        columns.push_back(std::move(col));
+        col = ColumnType();
+      }
+      return !scanner.fail();
+    }
+
+    void get_statistics(ParseStatistics& stats) const {
+      stats.n_bytes = file.get_size();
+      stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                    - start_time).count();
+    }
+
+  };
+
+} // namespace stn
@@ -0,0 +1,190 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include <cstring>
+
+#include "commons.hpp"
+
+namespace stn {
+
+  // Growable character buffer with fast integer formatting
+  class AsciiBuffer {
+  private:
+    std::vector<char> storage;
+    size_t used;
+
+    void reserve_more(const size_t n_bytes) {
+      if(used + n_bytes > storage.size())
+        storage.resize(std::max(2 * storage.size(), used + n_bytes));
+    }
+
+  public:
+    AsciiBuffer()
+      : storage(1 << 16)
+      , used(0)
+    {}
+
+    const char* data() const {
+      return storage.data();
+    }
+
+    size_t size() const {
+      return used;
+    }
+
+    void clear() {
+      used = 0;
+    }
+
+    void put(const char c) {
+      reserve_more(1);
+      storage[used++] = c;
+    }
+
+    void put(const char* s) {
+      const size_t n_bytes = strlen(s);
+      reserve_more(n_bytes);
+      memcpy(storage.data() + used, s, n_bytes);
+      used += n_bytes;
+    }
+
+    // Formats value two digits at a time
+    void put_index(const int64_t value) {
+      static const char digit_pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+      char digits[20];
+      char* position = digits + sizeof(digits);
+      uint64_t remainder = value < 0 ? 0 - (uint64_t) value : (uint64_t) value;
+      while(remainder >= 100) {
+        const size_t idx = (size_t) (remainder % 100) * 2;
+        remainder /= 100;
+        *--position = digit_pairs[idx + 1];
+        *--position = digit_pairs[idx];
+      }
+      if(remainder >= 10) {
+        const size_t idx = (size_t) remainder * 2;
+        *--position = digit_pairs[idx + 1];
+        *--position = digit_pairs[idx];
+      }
+      else {
+        *--position = (char) ('0' + remainder);
+      }
+
+      const size_t n_digits = digits + sizeof(digits) - position;
+      reserve_more(n_digits + 1);
+      if(value < 0)
+        storage[used++] = '-';
+      memcpy(storage.data() + used, position, n_digits);
+      used += n_digits;
+    }
+
+    // Formats a range of indices as [a, b, c]
+    template<typename Iterator>
+    void put_list(Iterator begin, Iterator end) {
+      put('[');
+      for(Iterator it = begin; it != end; ++it) {
+        if(it != begin)
+          put(", ");
+        put_index(*it);
+      }
+      put(']');
+    }
+
+  };
+
+
+  // Buffered text file writer. Output is only handed to the stream in large
+  // blocks, and write_range formats independent ranges of items into
+  // per-chunk buffers in parallel before writing them out in order.
+  class AsciiWriter {
+  private:
+    std::ofstream output_stream;
+    AsciiBuffer buffer;
+    std::vector<AsciiBuffer> chunk_buffers;
+
+    static const size_t flush_size = 1 << 22;
+    static const index_t chunk_size = 1 << 14;
+
+    void write_buffer(AsciiBuffer& buffer_out) {
+      output_stream.write(buffer_out.data(), buffer_out.size());
+      buffer_out.clear();
+    }
+
+  public:
+    AsciiWriter()
+      : output_stream()
+      , buffer()
+      , chunk_buffers()
+    {}
+
+    bool open(const std::string& filename) {
+      output_stream.open(filename.c_str());
+      return !output_stream.fail();
+    }
+
+    void put(const char c) {
+      buffer.put(c);
+    }
+
+    void put(const char* s) {
+      buffer.put(s);
+    }
+
+    void put_index(const int64_t value) {
+      buffer.put_index(value);
+    }
+
+    void flush_if_full() {
+      if(buffer.size() >= flush_size)
+        write_buffer(buffer);
+    }
+
+    // Calls format(buffer, chunk_begin, chunk_end) over consecutive chunks
+    // of [begin, end). Chunks are formatted concurrently when more than one
+    // thread is available, and always written in order.
+    template<typename Format>
+    void write_range(const index_t begin, const index_t end, Format format) {
+      const index_t n_threads = omp_get_max_threads();
+      if(n_threads == 1 || end - begin <= chunk_size) {
+        for(index_t chunk_begin = begin; chunk_begin < end; chunk_begin += chunk_size) {
+          format(buffer, chunk_begin, std::min(end, chunk_begin + chunk_size));
+          flush_if_full();
+        }
+        return;
+      }
+
+      write_buffer(buffer);
+      const index_t n_chunks = 4 * n_threads;
+      chunk_buffers.resize(n_chunks);
+      for(index_t batch_begin = begin; batch_begin < end;
+          batch_begin += n_chunks * chunk_size) {
+        const index_t n_batch_chunks =
+          std::min(n_chunks, (end - batch_begin + chunk_size - 1) / chunk_size);
+
+        #pragma omp parallel for schedule(dynamic)
+        for(index_t chunk = 0; chunk < n_batch_chunks; ++chunk) {
+          const index_t chunk_begin = batch_begin + chunk * chunk_size;
+          format(chunk_buffers[chunk], chunk_begin,
+                 std::min(end, chunk_begin + chunk_size));
+        }
+
+        for(index_t chunk = 0; chunk < n_batch_chunks; ++chunk)
+          write_buffer(chunk_buffers[chunk]);
+      }
+    }
+
+    bool close() {
+      write_buffer(buffer);
+      output_stream.close();
+      return !output_stream.fail();
+    }
+
+  };
+
+} // namespace stn
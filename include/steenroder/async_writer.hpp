@@ -0,0 +1,109 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "commons.hpp"
+
+namespace stn {
+
+  // Runs write tasks in order on a single background thread, so that dumps
+  // of intermediate matrices do not hold up the computation. Only dumps
+  // whose name is part of the selection given at construction are written,
+  // a comma separated list of names in which "all" selects every dump and
+  // "none" none. Other names that are not among the known ones are
+  // reported, since they select nothing.
+  class AsyncWriter {
+  private:
+    bool select_all;
+    std::set<std::string> selection;
+
+    std::queue<std::function<void()>> tasks;
+    bool busy;
+    bool stopping;
+    std::mutex mutex;
+    std::condition_variable task_available;
+    std::condition_variable task_done;
+    std::thread worker;
+
+    AsyncWriter(const AsyncWriter&) = delete;
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+    void run() {
+      std::unique_lock<std::mutex> lock(mutex);
+      while(true) {
+        task_available.wait(lock, [&]() { return stopping || !tasks.empty(); });
+        if(tasks.empty())
+          return;
+
+        std::function<void()> task = std::move(tasks.front());
+        tasks.pop();
+        busy = true;
+        lock.unlock();
+        task();
+        lock.lock();
+        busy = false;
+        task_done.notify_all();
+      }
+    }
+
+  public:
+    AsyncWriter(const std::string& selection_in,
+                const std::set<std::string>& known_names)
+      : select_all(false)
+      , selection()
+      , tasks()
+      , busy(false)
+      , stopping(false)
+    {
+      std::stringstream ss(selection_in);
+      std::string name;
+      while(std::getline(ss, name, ',')) {
+        if(name == "all")
+          select_all = true;
+        else if(name != "none" && !known_names.count(name))
+          std::cerr << "Unknown matrix to write " << name << ", ignored" << std::endl;
+        else
+          selection.insert(name);
+      }
+
+      worker = std::thread(&AsyncWriter::run, this);
+    }
+
+    ~AsyncWriter() {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+      }
+      task_available.notify_one();
+      worker.join();
+    }
+
+    bool is_selected(const std::string& name) const {
+      return select_all || selection.count(name);
+    }
+
+    void submit(std::function<void()> task) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push(std::move(task));
+      }
+      task_available.notify_one();
+    }
+
+    // Blocks until every submitted task has completed
+    void wait() {
+      std::unique_lock<std::mutex> lock(mutex);
+      task_done.wait(lock, [&]() { return tasks.empty() && !busy; });
+    }
+
+  };
+
+} // namespace stn
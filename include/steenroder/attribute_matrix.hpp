@@ -7,6 +7,9 @@
 #include "commons.hpp"
 #include "sparse_matrix.hpp"
 #include "vector_column.hpp"
+#include "ascii_reader.hpp"
+#include "binary_format.hpp"
+#include "ascii_writer.hpp"
 
 namespace stn {
 
@@ -36,9 +39,15 @@ namespace stn {
       , attributes(attributes_in)
     {};
 
-    AttributeMatrix(const AttributeMatrix<ColumnType>& other) {
-      *this = other;
-    }
+    AttributeMatrix(const AttributeMatrix<ColumnType>& other)
+      : Base(other)
+      , attributes(other.attributes)
+    {}
+
+    AttributeMatrix(AttributeMatrix<ColumnType>&& other)
+      : Base(std::move(other))
+      , attributes(std::move(other.attributes))
+    {}
 
     AttributeType get_attribute(index_t idx) const {
       return attributes[idx];
@@ -77,10 +86,8 @@ namespace stn {
     }
 
     AttributeType is_in(index_t start, VectorColumn& candidate){
-      VectorColumn temp_col;
       for(index_t idx = start; idx < get_n_columns(); ++idx) {
-        Base::get_column(idx, temp_col);
-        if(temp_col == candidate) {
+        if(Base::get_span(idx).equals(candidate)) {
           return get_attribute(idx);
         }
       }
@@ -93,12 +100,8 @@ namespace stn {
       if(n_columns != other.get_n_columns())
         return false;
 
-      VectorColumn temp_col;
-      VectorColumn other_temp_col;
       for(index_t idx = 0; idx < n_columns; ++idx) {
-        Base::get_column(idx, temp_col);
-        other.get_column(idx, other_temp_col);
-        if(temp_col != other_temp_col
+        if(!Base::get_span(idx).equals(other.get_span(idx))
            || get_attribute(idx) != other.get_attribute(idx))
           return false;
       }
@@ -111,146 +114,83 @@ namespace stn {
 
     AttributeMatrix<ColumnType>&
     operator=(const AttributeMatrix<ColumnType>& other) {
-      const index_t n_columns = other.get_n_columns();
-      set_n_columns(n_columns);
-
-      VectorColumn temp_col;
-      for(index_t idx = 0; idx <  n_columns; ++idx) {
-        set_attribute(idx, other.get_attribute(idx));
-        other.get_column(idx, temp_col);
-        Base::set_column(idx, temp_col);
-      }
+      Base::operator=(other);
+      attributes = other.attributes;
+      return *this;
+    }
 
+    AttributeMatrix<ColumnType>&
+    operator=(AttributeMatrix<ColumnType>&& other) {
+      Base::operator=(std::move(other));
+      attributes = std::move(other.attributes);
       return *this;
     }
 
-    bool load_ascii(std::string filename) {
-      // first count number of columns:
-      std::string line;
-      std::ifstream dummy(filename .c_str());
-      if(dummy.fail())
+    bool load_ascii(std::string filename, ParseStatistics& stats) {
+      AsciiReader reader;
+      if(!reader.open(filename))
         return false;
 
-      index_t n_columns = 0;
-      while(getline(dummy, line)) {
-        line.erase(line.find_last_not_of(" \t\n\r\f\v") + 1);
-        if(line != "" && line[0] != '#')
-          n_columns++;
-
-      }
-      set_n_columns(n_columns);
-      dummy.close();
-
-      std::ifstream input_stream(filename.c_str());
-      if(input_stream.fail())
+      std::vector<ColumnType> columns;
+      attributes.clear();
+      if(!reader.read_columns(columns, attributes))
         return false;
 
-      VectorColumn temp_col;
-      index_t idx = -1;
-      while(getline(input_stream, line)) {
-        line.erase(line.find_last_not_of(" \t\n\r\f\v") + 1);
-        if(line != "" && line[0] != '#') {
-          idx++;
-          std::stringstream ss(line);
-
-          index_t att;
-          ss >> att;
-          set_attribute(idx, (AttributeType) att);
-
-          index_t temp_index;
-          temp_col.clear();
-          while(ss.good()) {
-            ss >> temp_index;
-            temp_col.push_back((index_t)temp_index);
-          }
-          std::sort(temp_col.begin(), temp_col.end());
-          Base::set_column(idx, temp_col);
-        }
-      }
-
-      input_stream.close();
+      Base::load_columns(columns);
+      reader.get_statistics(stats);
       return true;
     }
 
+    bool load_ascii(std::string filename) {
+      ParseStatistics stats;
+      return load_ascii(filename, stats);
+    }
+
     // Format: each line represents a column, first number is attribute, other numbers are the content of the column
-    bool save_ascii(const std::string& name, const std::string& output_filename) {
+    bool save_ascii(const std::string& name, const std::string& output_filename) const {
       std::string filename = output_filename + "_" + name + ".dat";
-
-      std::ofstream output_stream(filename.c_str());
-      if(output_stream.fail())
+      AsciiWriter writer;
+      if(!writer.open(filename))
         return false;
 
-      const index_t n_columns = Base::get_n_columns();
-      VectorColumn temp_col;
-      for(index_t col_idx = 0; col_idx < n_columns; ++col_idx) {
-        output_stream << (index_t) get_attribute(col_idx);
-
-        Base::get_column(col_idx, temp_col);
-        for(index_t row_idx = 0; row_idx < (index_t) temp_col.size(); ++row_idx)
-          output_stream << " " << temp_col[row_idx];
-        output_stream << std::endl;
-      }
+      writer.write_range(0, Base::get_n_columns(),
+        [&](AsciiBuffer& buffer, index_t begin, index_t end) {
+          for(index_t col_idx = begin; col_idx < end; ++col_idx) {
+            buffer.put_index((index_t) get_attribute(col_idx));
+            for(const typename Base::column_index_t* row = Base::column_begin(col_idx);
+                row != Base::column_end(col_idx); ++row) {
+              buffer.put(' ');
+              buffer.put_index(*row);
+            }
+            buffer.put('\n');
+          }
+        });
 
-      output_stream.close();
-      return true;
+      return writer.close();
     }
 
-    // Format: n_columns % att1 % N1 % row1 row2 % ...% rowN1 % att2 % N2 % ...
+    // Accepts both binary layouts described in binary_format.hpp
     bool load_binary(std::string filename) {
-      std::ifstream input_stream(filename.c_str(), std::ios_base::binary | std::ios_base::in);
-      if(input_stream.fail())
+      std::vector<ColumnType> columns;
+      if(!load_binary_columns(filename, columns, attributes))
         return false;
 
-      index_t n_columns;
-      input_stream.read((char*) &n_columns, sizeof(int64_t));
-      set_n_columns((index_t) n_columns);
-
-      VectorColumn temp_col;
-      for(index_t idx = 0; idx < n_columns; idx++) {
-        index_t att;
-        input_stream.read((char*) &att, sizeof(int64_t));
-        set_attribute(idx, (AttributeType) att);
-        index_t n_rows;
-        input_stream.read((char*) &n_rows, sizeof(int64_t));
-        temp_col.resize((std::size_t) n_rows);
-        for(index_t idx = 0; idx < n_rows; ++idx) {
-          index_t row;
-          input_stream.read((char*)& row, sizeof(int64_t));
-          temp_col[idx] = (index_t) row;
-        }
-        Base::set_column(idx, temp_col);
-      }
-
-      input_stream.close();
+      Base::load_columns(columns);
       return true;
     }
 
-    // Format: n_columns % att1 % N1 % row1 row2 % ...% rowN1 % att2 % N2 % ...
-    bool save_binary(const std::string& name, const std::string& output_filename) {
-      std::string filename = output_filename + "_" + name + ".dat";
-
-      std::ofstream output_stream(filename.c_str(),
-                                  std::ios_base::binary | std::ios_base::out);
-      if(output_stream.fail())
-        return false;
+    // Writes the CSR layout described in binary_format.hpp
+    bool save_binary(const std::string& filename) const {
+      return save_binary_columns(filename, *this, attributes);
+    }
 
-      const index_t n_columns = Base::get_n_columns();
-      output_stream.write((char*) &n_columns, sizeof(int64_t));
-      VectorColumn temp_col;
-      for(index_t idx = 0; idx < n_columns; idx++) {
-        index_t att = get_attribute(idx);
-        output_stream.write((char*) &att, sizeof(int64_t));
-        Base::get_column(idx, temp_col);
-        index_t n_rows = temp_col.size();
-        output_stream.write((char*) &n_rows, sizeof(int64_t));
-        for(index_t row_idx = 0; row_idx < (index_t) temp_col.size(); row_idx++) {
-          index_t row = temp_col[row_idx];
-          output_stream.write((char*) &row, sizeof(int64_t));
-        }
-      }
+    bool save_binary(const std::string& name, const std::string& output_filename) const {
+      return save_binary(output_filename + "_" + name + ".dat");
+    }
 
-      output_stream.close();
-      return true;
+    // Writes the compressed layout described in compressed_format.hpp
+    bool save_compressed(const std::string& filename) const {
+      return save_compressed_columns(filename, *this, attributes);
     }
 
   };
@@ -267,14 +207,13 @@ namespace stn {
       const dimension_t n_elements = sparse_matrices.size();
 
       dimension_t elem;
-      ColumnType temp_col;
       std::vector<index_t> indices(n_elements, 0);
       for(index_t idx_col = 0; idx_col < n_columns; ++idx_col) {
         elem = attribute_matrix.get_attribute(idx_col);
-        attribute_matrix.get_column(idx_col, temp_col);
 
         attribute_vectors[elem][indices[elem]] = idx_col;
-        sparse_matrices[elem].set_column(indices[elem], temp_col);
+        sparse_matrices[elem].set_column(indices[elem],
+                                         attribute_matrix.get_span(idx_col));
 
         ++indices[elem];
       }
@@ -289,14 +228,13 @@ namespace stn {
       const dimension_t n_elements = sparse_matrices.size();
 
       dimension_t elem;
-      ColumnType temp_col;
       std::vector<index_t> indices(n_elements, 0);
       for(index_t idx_col = 0; idx_col < n_columns; ++idx_col) {
         elem = n_elements - 1 - attribute_matrix.get_attribute(idx_col);
-        attribute_matrix.get_column(idx_col, temp_col);
 
         attribute_vectors[elem][indices[elem]] = n_columns - 1 - idx_col;
-        sparse_matrices[elem].set_column(indices[elem], temp_col);
+        sparse_matrices[elem].set_column(indices[elem],
+                                         attribute_matrix.get_span(idx_col));
 
         ++indices[elem];
       }
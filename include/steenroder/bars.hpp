@@ -7,6 +7,7 @@
 #include "commons.hpp"
 #include "boundary_matrix.hpp"
 #include "vector_column.hpp"
+#include "ascii_writer.hpp"
 
 namespace stn {
 
@@ -30,16 +31,22 @@ namespace stn {
       , births(boundaryMatrix_in.get_n_columns(), -1)
     {};
 
+    // Takes over the columns of boundaryMatrix_in, which is left empty
+    InfiniteBars(BoundaryMatrix<ColumnType>&& boundaryMatrix_in,
+                 const dimension_t n_dimensions_in)
+      : Base(std::move(boundaryMatrix_in))
+      , n_dimensions(n_dimensions_in)
+      , n_cells(Base::get_n_columns())
+      , births(Base::get_n_columns(), -1)
+    {};
+
     InfiniteBars(const dimension_t n_dimensions_in, const index_t n_cells_in)
       : Base(n_cells_in)
       , n_dimensions(n_dimensions_in)
       , n_cells(n_cells_in)
       , births(n_cells_in, -1)
     {
-      for(index_t index = 0; index < n_cells_in; ++index) {
-        VectorColumn col = VectorColumn(1, index);
-        this->set_column(index, col);
-      }
+      this->set_identity(n_cells_in);
     };
 
     using Base::set_n_columns;
@@ -85,6 +92,12 @@ namespace stn {
       , deaths(boundaryMatrix_in.get_n_columns(), -1)
     {};
 
+    FiniteBars(BoundaryMatrix<ColumnType>&& boundaryMatrix_in,
+               const dimension_t n_dimensions_in)
+      : Base(std::move(boundaryMatrix_in), n_dimensions_in)
+      , deaths(Base::get_n_columns(), -1)
+    {};
+
     using Base::set_n_columns;
     using Base::get_n_columns;
     using Base::set_birth;
@@ -119,28 +132,38 @@ namespace stn {
   bool save_pairs_ascii(const std::string& filename,
                         const FiniteBars<ColumnType>& finite_bars,
                         const InfiniteBars<ColumnType>& infinite_bars) {
-    std::ofstream output_stream(filename.c_str());
-    if(output_stream.fail())
+    AsciiWriter writer;
+    if(!writer.open(filename))
       return false;
 
     index_t n_finite_pairs = finite_bars.get_n_columns();
     index_t n_infinite_pairs = infinite_bars.get_n_columns();
-    output_stream << n_finite_pairs + n_infinite_pairs << std::endl;
-
-    for(index_t index = 0; index < n_finite_pairs; ++index) {
-      output_stream << (int64_t) finite_bars.get_dimension(index) << " "
-                    << finite_bars.get_birth(index) << " "
-                    << finite_bars.get_death(index) << std::endl;
-    }
-
-    for(index_t index = 0; index < n_infinite_pairs; ++index) {
-      output_stream << (int64_t) infinite_bars.get_dimension(index) << " "
-                    << infinite_bars.get_birth(index) << " -1"
-                    << std::endl;
-    }
-
-    output_stream.close();
-    return true;
+    writer.put_index(n_finite_pairs + n_infinite_pairs);
+    writer.put('\n');
+
+    writer.write_range(0, n_finite_pairs,
+      [&](AsciiBuffer& buffer, index_t begin, index_t end) {
+        for(index_t index = begin; index < end; ++index) {
+          buffer.put_index(finite_bars.get_dimension(index));
+          buffer.put(' ');
+          buffer.put_index(finite_bars.get_birth(index));
+          buffer.put(' ');
+          buffer.put_index(finite_bars.get_death(index));
+          buffer.put('\n');
+        }
+      });
+
+    writer.write_range(0, n_infinite_pairs,
+      [&](AsciiBuffer& buffer, index_t begin, index_t end) {
+        for(index_t index = begin; index < end; ++index) {
+          buffer.put_index(infinite_bars.get_dimension(index));
+          buffer.put(' ');
+          buffer.put_index(infinite_bars.get_birth(index));
+          buffer.put(" -1\n");
+        }
+      });
+
+    return writer.close();
   }
 
   // Saves the persistence pairs to given file in binary format
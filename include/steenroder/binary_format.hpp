@@ -0,0 +1,399 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include <cstring>
+#include <limits>
+
+#include "commons.hpp"
+#include "mapped_file.hpp"
+#include "compressed_format.hpp"
+#include "dimension_index.hpp"
+
+namespace stn {
+
+  // Binary matrix files come in three layouts, all native endian. The
+  // compressed one is described in compressed_format.hpp.
+  //
+  // Legacy: n_columns % att1 % N1 % row1 row2 % ...% rowN1 % att2 % N2 % ...
+  // with every value stored as an int64_t.
+  //
+  // CSR (version 2):
+  //   header
+  //   attributes  n_columns values of attribute_bytes each, padded to 8 bytes
+  //   offsets     n_columns + 1 int64_t, column i spans [offsets[i], offsets[i+1])
+  //   rows        n_entries row indices of index_bytes each
+  //   index       dimension index described in dimension_index.hpp
+  // Version 1 files have no index, it is rebuilt from the attributes.
+  struct BinaryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t index_bytes;
+    uint32_t attribute_bytes;
+    uint32_t reserved;
+    int64_t n_columns;
+    int64_t n_entries;
+  };
+
+  static const char binary_magic[8] = {'S', 'T', 'N', 'C', 'S', 'R', '\0', '\0'};
+  static const uint32_t binary_version = 2;
+
+  inline size_t binary_padded_size(const size_t n_bytes) {
+    return (n_bytes + sizeof(int64_t) - 1) / sizeof(int64_t) * sizeof(int64_t);
+  }
+
+  inline bool is_csr_file(const MappedFile& file) {
+    return file.get_size() >= sizeof(BinaryHeader)
+      && memcmp(file.begin(), binary_magic, sizeof(binary_magic)) == 0;
+  }
+
+
+  inline bool is_csr_file(const std::string& filename) {
+    MappedFile file;
+    return file.open(filename, false) && is_csr_file(file);
+  }
+
+  // Validated view of a CSR file that is already mapped in memory
+  class CsrReader {
+  private:
+    BinaryHeader header;
+    const char* attributes;
+    const int64_t* offsets;
+    const int64_t* rows;
+    DimensionIndex index;
+
+  public:
+    CsrReader()
+      : header()
+      , attributes(nullptr)
+      , offsets(nullptr)
+      , rows(nullptr)
+      , index()
+    {}
+
+    bool attach(const MappedFile& file) {
+      if(!is_csr_file(file))
+        return false;
+
+      memcpy(&header, file.begin(), sizeof(BinaryHeader));
+      if(header.version < 1 || header.version > binary_version
+         || header.index_bytes != sizeof(int64_t)
+         || (header.attribute_bytes != 1 && header.attribute_bytes != 2
+             && header.attribute_bytes != 4 && header.attribute_bytes != 8)
+         || header.n_columns < 0 || header.n_entries < 0)
+        return false;
+
+      const size_t n_columns = (size_t) header.n_columns;
+      const size_t attributes_start = sizeof(BinaryHeader);
+      const size_t offsets_start = attributes_start
+        + binary_padded_size(n_columns * header.attribute_bytes);
+      const size_t rows_start = offsets_start + (n_columns + 1) * sizeof(int64_t);
+      const size_t rows_end = rows_start + (size_t) header.n_entries * sizeof(int64_t);
+      if(rows_end > file.get_size())
+        return false;
+
+      attributes = file.begin() + attributes_start;
+      offsets = (const int64_t*) (file.begin() + offsets_start);
+      rows = (const int64_t*) (file.begin() + rows_start);
+
+      if(offsets[0] != 0 || offsets[n_columns] != header.n_entries)
+        return false;
+      for(size_t idx_col = 0; idx_col < n_columns; ++idx_col) {
+        if(offsets[idx_col] > offsets[idx_col + 1])
+          return false;
+      }
+
+      if(header.version == 1) {
+        index.build(get_n_columns(), dimension_block_size,
+                    [&](index_t idx_col) { return get_attribute(idx_col); });
+        return true;
+      }
+      return index.read(file.begin() + rows_end, file.end(), get_n_columns(),
+                        dimension_block_size);
+    }
+
+    index_t get_n_columns() const {
+      return (index_t) header.n_columns;
+    }
+
+    index_t get_n_entries() const {
+      return (index_t) header.n_entries;
+    }
+
+    int64_t get_attribute(const index_t idx_col) const {
+      return read_packed_attribute(attributes + idx_col * header.attribute_bytes,
+                                   header.attribute_bytes);
+    }
+
+    const DimensionIndex& get_dimension_index() const {
+      return index;
+    }
+
+    const int64_t* get_offsets() const {
+      return offsets;
+    }
+
+    const int64_t* get_rows() const {
+      return rows;
+    }
+
+    const int64_t* column_begin(const index_t idx_col) const {
+      return rows + offsets[idx_col];
+    }
+
+    const int64_t* column_end(const index_t idx_col) const {
+      return rows + offsets[idx_col + 1];
+    }
+
+  };
+
+
+  inline bool read_binary_n_columns(const MappedFile& file, index_t& n_columns) {
+    if(is_compressed_file(file)) {
+      CompressedReader reader;
+      if(!reader.attach(file))
+        return false;
+      n_columns = reader.get_n_columns();
+      return true;
+    }
+
+    if(is_csr_file(file)) {
+      CsrReader reader;
+      if(!reader.attach(file))
+        return false;
+      n_columns = reader.get_n_columns();
+      return true;
+    }
+
+    if(file.get_size() < sizeof(int64_t))
+      return false;
+    int64_t n_columns_in;
+    memcpy(&n_columns_in, file.begin(), sizeof(int64_t));
+    n_columns = (index_t) n_columns_in;
+    return n_columns >= 0;
+  }
+
+  // Walks the columns of a file in any binary layout whose attribute lies in
+  // [min_dim, max_dim], calling visit(idx_col, attribute, rows, n_rows) for
+  // each of them. Blocks without such a column are skipped through the
+  // dimension index. Returns false on malformed or truncated input.
+  template<typename Visitor>
+  bool scan_binary(const MappedFile& file, const int64_t min_dim,
+                   const int64_t max_dim, Visitor visit) {
+    if(is_compressed_file(file)) {
+      CompressedReader reader;
+      if(!reader.attach(file))
+        return false;
+
+      const DimensionIndex& index = reader.get_dimension_index();
+      std::vector<int64_t> col;
+      for(index_t block = 0; block < reader.get_n_blocks(); ++block) {
+        if(!index.intersects(block, min_dim, max_dim))
+          continue;
+        bool valid = reader.decode_block(block, min_dim, max_dim, col,
+          [&](index_t idx_col, int64_t att, const std::vector<int64_t>& rows) {
+            visit(idx_col, att, rows.data(), (int64_t) rows.size());
+          });
+        if(!valid)
+          return false;
+      }
+      return true;
+    }
+
+    if(is_csr_file(file)) {
+      CsrReader reader;
+      if(!reader.attach(file))
+        return false;
+
+      const DimensionIndex& index = reader.get_dimension_index();
+      const index_t n_columns = reader.get_n_columns();
+      const index_t block_size = index.get_block_size();
+      for(index_t block = 0; block < index.get_n_blocks(); ++block) {
+        if(!index.intersects(block, min_dim, max_dim))
+          continue;
+        const index_t end = std::min(n_columns, (block + 1) * block_size);
+        for(index_t idx_col = block * block_size; idx_col < end; ++idx_col) {
+          const int64_t att = reader.get_attribute(idx_col);
+          if(att >= min_dim && att <= max_dim)
+            visit(idx_col, att, reader.column_begin(idx_col),
+                  (int64_t) (reader.column_end(idx_col) - reader.column_begin(idx_col)));
+        }
+      }
+      return true;
+    }
+
+    index_t n_columns;
+    if(!read_binary_n_columns(file, n_columns))
+      return false;
+
+    const int64_t* position = (const int64_t*) file.begin() + 1;
+    const int64_t* end = (const int64_t*) file.begin()
+      + file.get_size() / sizeof(int64_t);
+    for(index_t idx_col = 0; idx_col < n_columns; ++idx_col) {
+      if(end - position < 2)
+        return false;
+      int64_t att = position[0];
+      int64_t n_rows = position[1];
+      position += 2;
+      if(n_rows < 0 || end - position < n_rows)
+        return false;
+
+      if(att >= min_dim && att <= max_dim)
+        visit(idx_col, att, position, n_rows);
+      position += n_rows;
+    }
+    return true;
+  }
+
+  template<typename Visitor>
+  bool scan_binary(const MappedFile& file, Visitor visit) {
+    return scan_binary(file, std::numeric_limits<int64_t>::min(),
+                       std::numeric_limits<int64_t>::max(), visit);
+  }
+
+  // Reads the attribute of every column without decoding any of them
+  template<typename AttributeType>
+  bool read_binary_attributes(const MappedFile& file,
+                              std::vector<AttributeType>& attributes) {
+    if(is_compressed_file(file)) {
+      CompressedReader reader;
+      if(!reader.attach(file))
+        return false;
+      attributes.resize(reader.get_n_columns());
+      for(index_t idx_col = 0; idx_col < reader.get_n_columns(); ++idx_col)
+        attributes[idx_col] = (AttributeType) reader.get_attribute(idx_col);
+      return true;
+    }
+
+    if(is_csr_file(file)) {
+      CsrReader reader;
+      if(!reader.attach(file))
+        return false;
+      attributes.resize(reader.get_n_columns());
+      for(index_t idx_col = 0; idx_col < reader.get_n_columns(); ++idx_col)
+        attributes[idx_col] = (AttributeType) reader.get_attribute(idx_col);
+      return true;
+    }
+
+    // The legacy layout interleaves attributes with the rows
+    index_t n_columns;
+    if(!read_binary_n_columns(file, n_columns))
+      return false;
+    attributes.assign(n_columns, 0);
+    return scan_binary(file,
+      [&](index_t idx_col, int64_t att, const int64_t* /* rows */, int64_t /* n_rows */) {
+        attributes[idx_col] = (AttributeType) att;
+      });
+  }
+
+  // Only the columns whose attribute lies in [min_dim, max_dim] are read,
+  // all others are left empty. Attributes are read for every column.
+  template<typename ColumnType, typename AttributeType>
+  bool load_binary_columns(const std::string& filename,
+                           std::vector<ColumnType>& columns,
+                           std::vector<AttributeType>& attributes,
+                           const int64_t min_dim, const int64_t max_dim) {
+    MappedFile file;
+    if(!file.open(filename))
+      return false;
+    if(is_compressed_file(file))
+      return load_compressed_columns(file, columns, attributes, min_dim, max_dim);
+    if(is_csr_file(file)) {
+      if(!read_binary_attributes(file, attributes))
+        return false;
+
+      columns.clear();
+      columns.resize(attributes.size());
+      return scan_binary(file, min_dim, max_dim,
+        [&](index_t idx_col, int64_t /* att */, const int64_t* rows, int64_t n_rows) {
+          columns[idx_col].assign(rows, rows + n_rows);
+        });
+    }
+
+    // The legacy layout interleaves attributes with the rows, so both are
+    // read in the same pass
+    index_t n_columns;
+    if(!read_binary_n_columns(file, n_columns))
+      return false;
+    attributes.assign(n_columns, 0);
+    columns.clear();
+    columns.resize(n_columns);
+    return scan_binary(file,
+      [&](index_t idx_col, int64_t att, const int64_t* rows, int64_t n_rows) {
+        attributes[idx_col] = (AttributeType) att;
+        if(att >= min_dim && att <= max_dim)
+          columns[idx_col].assign(rows, rows + n_rows);
+      });
+  }
+
+  template<typename ColumnType, typename AttributeType>
+  bool load_binary_columns(const std::string& filename,
+                           std::vector<ColumnType>& columns,
+                           std::vector<AttributeType>& attributes) {
+    return load_binary_columns(filename, columns, attributes,
+                               std::numeric_limits<int64_t>::min(),
+                               std::numeric_limits<int64_t>::max());
+  }
+
+  // Writes rows as int64_t, through buffer when they are stored narrower
+  template<typename IndexType>
+  void write_rows(std::ostream& output_stream, const IndexType* begin,
+                  const IndexType* end, std::vector<int64_t>& buffer) {
+    buffer.assign(begin, end);
+    output_stream.write((const char*) buffer.data(), buffer.size() * sizeof(int64_t));
+  }
+
+  inline void write_rows(std::ostream& output_stream, const int64_t* begin,
+                         const int64_t* end, std::vector<int64_t>& /* buffer */) {
+    output_stream.write((const char*) begin, (end - begin) * sizeof(int64_t));
+  }
+
+  // Writes the columns of matrix in the CSR layout. Rows are written column
+  // by column straight from the matrix, the stream buffers them.
+  template<typename Matrix, typename AttributeType>
+  bool save_binary_columns(const std::string& filename, const Matrix& matrix,
+                           const std::vector<AttributeType>& attributes) {
+    std::ofstream output_stream(filename.c_str(),
+                                std::ios_base::binary | std::ios_base::out);
+    if(output_stream.fail())
+      return false;
+
+    const index_t n_columns = matrix.get_n_columns();
+    std::vector<int64_t> offsets(n_columns + 1, 0);
+    for(index_t idx_col = 0; idx_col < n_columns; ++idx_col)
+      offsets[idx_col + 1] = offsets[idx_col]
+        + (int64_t) (matrix.column_end(idx_col) - matrix.column_begin(idx_col));
+
+    BinaryHeader header;
+    memset(&header, 0, sizeof(BinaryHeader));
+    memcpy(header.magic, binary_magic, sizeof(binary_magic));
+    header.version = binary_version;
+    header.index_bytes = sizeof(int64_t);
+    header.attribute_bytes = sizeof(AttributeType);
+    header.n_columns = n_columns;
+    header.n_entries = offsets[n_columns];
+    output_stream.write((const char*) &header, sizeof(BinaryHeader));
+
+    const size_t attributes_size = n_columns * sizeof(AttributeType);
+    output_stream.write((const char*) attributes.data(), attributes_size);
+    const char padding[sizeof(int64_t)] = {0};
+    output_stream.write(padding, binary_padded_size(attributes_size) - attributes_size);
+
+    output_stream.write((const char*) offsets.data(), offsets.size() * sizeof(int64_t));
+    std::vector<int64_t> buffer;
+    for(index_t idx_col = 0; idx_col < n_columns; ++idx_col)
+      write_rows(output_stream, matrix.column_begin(idx_col), matrix.column_end(idx_col),
+                 buffer);
+
+    DimensionIndex index;
+    index.build(n_columns, dimension_block_size,
+                [&](index_t idx_col) { return (int64_t) attributes[idx_col]; });
+    index.write(output_stream);
+
+    output_stream.close();
+    return !output_stream.fail();
+  }
+
+} // namespace stn
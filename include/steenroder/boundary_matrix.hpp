@@ -16,11 +16,13 @@ namespace stn {
     using Base = AttributeMatrix<ColumnType>;
 
   public:
+    using column_index_t = typename Base::column_index_t;
     using Base::Base;
     using Base::get_column;
     using Base::load_binary;
     using Base::save_ascii;
     using Base::save_binary;
+    using Base::save_compressed;
     using Base::set_n_columns;
     using Base::get_n_columns;
     using Base::load_ascii;
@@ -47,11 +49,10 @@ namespace stn {
 
       std::vector<index_t> dual_sizes(n_columns, 0);
 
-      VectorColumn temp_col;
       for(index_t idx_col = 0; idx_col < n_columns; ++idx_col) {
-        Base::get_column(idx_col, temp_col);
-        for(index_t idx_col = 0; idx_col < (index_t) temp_col.size(); ++idx_col)
-          ++dual_sizes[n_columns - 1 - temp_col[idx_col]];
+        const ColumnSpan<column_index_t> col = Base::get_span(idx_col);
+        for(index_t idx_col = 0; idx_col < (index_t) col.size(); ++idx_col)
+          ++dual_sizes[n_columns - 1 - col[idx_col]];
       }
 
       #pragma omp parallel for
@@ -59,9 +60,9 @@ namespace stn {
         dual_matrix[idx_col].reserve(dual_sizes[idx_col]);
 
       for(index_t idx_col = 0; idx_col < n_columns; idx_col++) {
-        Base::get_column(idx_col, temp_col);
-        for(index_t idx_row = 0; idx_row < (index_t) temp_col.size(); idx_row++)
-          dual_matrix[n_columns - 1 - temp_col[idx_row]].push_back(n_columns - 1 - idx_col);
+        const ColumnSpan<column_index_t> col = Base::get_span(idx_col);
+        for(index_t idx_row = 0; idx_row < (index_t) col.size(); idx_row++)
+          dual_matrix[n_columns - 1 - col[idx_row]].push_back(n_columns - 1 - idx_col);
       }
 
       const dimension_t n_dimensions = get_max_dimension() + 1;
@@ -83,19 +84,19 @@ namespace stn {
                             const std::vector<dimemsion_type>& input_dimensions) {
       const index_t n_columns = (index_t) input_matrix.size();
       Base::set_n_columns(n_columns);
-      VectorColumn temp_col;
-#pragma omp parallel for private(temp_col)
+      std::vector<ColumnType> columns(n_columns);
+#pragma omp parallel for
       for(index_t idx_col = 0; idx_col < n_columns; ++idx_col) {
         set_dimension(idx_col, (dimension_t) input_dimensions[idx_col]);
 
         index_t n_rows = input_matrix[idx_col].size();
-        temp_col.resize(n_rows);
+        columns[idx_col].resize(n_rows);
 
         for(index_t idx_row = 0; idx_row < n_rows; ++idx_row) {
-          temp_col[idx_row] = (index_t) input_matrix[idx_col][idx_row];
+          columns[idx_col][idx_row] = (index_t) input_matrix[idx_col][idx_row];
         }
-        Base::set_column(idx_col, temp_col);
       }
+      Base::load_columns(columns);
     }
 
   };
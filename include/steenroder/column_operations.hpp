@@ -0,0 +1,60 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include <algorithm>
+
+#include "commons.hpp"
+#include "symmetric_difference.hpp"
+
+namespace stn {
+
+  // Set algebra on sorted columns writing to a caller provided column out,
+  // which must not be one of the operands. out is resized to the result but
+  // keeps its storage, so a buffer reused across calls stops allocating once
+  // it has grown to the largest result. Operands may be columns or spans.
+
+  // out = a + b over Z2
+  template<typename Left, typename Right, typename ColumnType>
+  void column_sum(const Left& a, const Right& b, ColumnType& out) {
+    out.resize(a.size() + b.size());
+    const typename ColumnType::value_type* out_end =
+      symmetric_difference(a.data(), a.data() + a.size(),
+                           b.data(), b.data() + b.size(), out.data());
+    out.resize(out_end - out.data());
+  }
+
+  // out = a \ b
+  template<typename Left, typename Right, typename ColumnType>
+  void column_difference(const Left& a, const Right& b, ColumnType& out) {
+    out.resize(a.size());
+    const typename ColumnType::value_type* out_end =
+      std::set_difference(a.data(), a.data() + a.size(),
+                          b.data(), b.data() + b.size(), out.data());
+    out.resize(out_end - out.data());
+  }
+
+  // out = a U b
+  template<typename Left, typename Right, typename ColumnType>
+  void column_union(const Left& a, const Right& b, ColumnType& out) {
+    out.resize(a.size() + b.size());
+    const typename ColumnType::value_type* out_end =
+      std::set_union(a.data(), a.data() + a.size(),
+                     b.data(), b.data() + b.size(), out.data());
+    out.resize(out_end - out.data());
+  }
+
+  // col = col U {row}
+  template<typename ColumnType>
+  void column_insert(ColumnType& col, const index_t row) {
+    const size_t position = std::lower_bound(col.begin(), col.end(), row) - col.begin();
+    if(position < col.size() && col[position] == row)
+      return;
+
+    col.push_back(row);
+    std::rotate(col.begin() + position, col.end() - 1, col.end());
+  }
+
+} // namespace stn
@@ -0,0 +1,87 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include <algorithm>
+
+#include "commons.hpp"
+
+namespace stn {
+
+  // Read-only view of the rows of a column stored in a matrix. It does not
+  // copy them and stays valid until that matrix is next modified.
+  template<typename IndexType>
+  class ColumnSpan {
+  public:
+    typedef IndexType value_type;
+    typedef const IndexType* iterator;
+    typedef const IndexType* const_iterator;
+    typedef size_t size_type;
+
+  private:
+    const IndexType* first;
+    const IndexType* last;
+
+  public:
+    ColumnSpan()
+      : first(nullptr)
+      , last(nullptr)
+    {}
+
+    ColumnSpan(const IndexType* first_in, const IndexType* last_in)
+      : first(first_in)
+      , last(last_in)
+    {}
+
+    const IndexType* data() const {
+      return first;
+    }
+
+    const_iterator begin() const {
+      return first;
+    }
+
+    const_iterator end() const {
+      return last;
+    }
+
+    size_t size() const {
+      return last - first;
+    }
+
+    bool empty() const {
+      return first == last;
+    }
+
+    const IndexType& operator[](const size_t idx) const {
+      return first[idx];
+    }
+
+    const IndexType& front() const {
+      return *first;
+    }
+
+    const IndexType& back() const {
+      return *(last - 1);
+    }
+
+    index_t get_max() const {
+      return empty() ? -1 : back();
+    }
+
+    // Compares the rows with those of any column type
+    template<typename Column>
+    bool equals(const Column& col) const {
+      return size() == (size_t) col.size() && std::equal(first, last, col.begin());
+    }
+
+  };
+
+  template<typename Column>
+  ColumnSpan<typename Column::value_type> make_span(const Column& col) {
+    return ColumnSpan<typename Column::value_type>(col.data(), col.data() + col.size());
+  }
+
+} // namespace stn
@@ -33,7 +33,8 @@
 #define STN_INSTRUMENT_OFF(name, colorID)
 
 
-// basic types. index_t can be changed to int32_t to save memory on small instances
+// basic types. Matrices store indices in the value type of their column type,
+// see VectorColumn32 to save memory on small instances
 namespace stn {
     typedef int64_t index_t;
     typedef int64_t filtration_t;
@@ -0,0 +1,400 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include <cstring>
+#include <limits>
+
+#include "commons.hpp"
+#include "mapped_file.hpp"
+#include "dimension_index.hpp"
+
+namespace stn {
+
+  // Compressed binary layout (version 2), native endian:
+  //   header
+  //   attributes     n_columns values of attribute_bytes each, padded to 8 bytes
+  //   block offsets  n_blocks + 1 int64_t byte offsets into the payload
+  //   payload        one independently decodable block per block_size columns,
+  //                  padded to 8 bytes
+  //   index          dimension index described in dimension_index.hpp, over
+  //                  the same blocks as the payload
+  // Version 1 files have no index, it is rebuilt from the attributes.
+  //
+  // A column is stored as varint(n_rows) followed by its rows from the largest
+  // down: zigzag(idx_col - max_row), then the gaps between consecutive rows.
+  // Varints are LEB128: 7 bits per byte, high bit set on all but the last.
+  struct CompressedHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t attribute_bytes;
+    uint32_t reserved;
+    int64_t n_columns;
+    int64_t n_entries;
+    int64_t n_blocks;
+    int64_t payload_bytes;
+  };
+
+  static const char compressed_magic[8] = {'S', 'T', 'N', 'V', 'A', 'R', '\0', '\0'};
+  static const uint32_t compressed_version = 2;
+  static const uint32_t compressed_block_size = 4096;
+
+  inline bool is_compressed_file(const MappedFile& file) {
+    return file.get_size() >= sizeof(CompressedHeader)
+      && memcmp(file.begin(), compressed_magic, sizeof(compressed_magic)) == 0;
+  }
+
+  // Reads an attribute stored on attribute_bytes bytes
+  inline int64_t read_packed_attribute(const char* address,
+                                       const uint32_t attribute_bytes) {
+    switch(attribute_bytes) {
+    case 1: { int8_t att; memcpy(&att, address, 1); return att; }
+    case 2: { int16_t att; memcpy(&att, address, 2); return att; }
+    case 4: { int32_t att; memcpy(&att, address, 4); return att; }
+    default: { int64_t att; memcpy(&att, address, 8); return att; }
+    }
+  }
+
+  inline uint64_t zigzag_encode(const int64_t value) {
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+  }
+
+  inline int64_t zigzag_decode(const uint64_t value) {
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+  }
+
+  inline void append_varint(std::vector<uint8_t>& buffer, uint64_t value) {
+    while(value >= 0x80) {
+      buffer.push_back((uint8_t) (value | 0x80));
+      value >>= 7;
+    }
+    buffer.push_back((uint8_t) value);
+  }
+
+  inline bool read_varint(const uint8_t*& position, const uint8_t* end,
+                          uint64_t& value) {
+    value = 0;
+    for(unsigned shift = 0; shift < 64; shift += 7) {
+      if(position == end)
+        return false;
+      const uint8_t byte = *position++;
+      value |= (uint64_t) (byte & 0x7f) << shift;
+      if(!(byte & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  template<typename IndexType>
+  void append_column(std::vector<uint8_t>& buffer, const index_t idx_col,
+                     const IndexType* col, const IndexType* col_end) {
+    const index_t n_rows = (index_t) (col_end - col);
+    append_varint(buffer, (uint64_t) n_rows);
+    if(n_rows == 0)
+      return;
+
+    append_varint(buffer, zigzag_encode(idx_col - col[n_rows - 1]));
+    for(index_t idx = n_rows - 1; idx > 0; --idx)
+      append_varint(buffer, (uint64_t) (col[idx] - col[idx - 1]));
+  }
+
+  template<typename ColumnType>
+  bool read_column(const uint8_t*& position, const uint8_t* end,
+                   const index_t idx_col, ColumnType& col) {
+    uint64_t value;
+    if(!read_varint(position, end, value))
+      return false;
+    const index_t n_rows = (index_t) value;
+    if(n_rows < 0 || n_rows > end - position)
+      return false;
+
+    col.resize(n_rows);
+    if(n_rows == 0)
+      return true;
+
+    if(!read_varint(position, end, value))
+      return false;
+    index_t row = idx_col - zigzag_decode(value);
+    col[n_rows - 1] = row;
+    for(index_t idx = n_rows - 1; idx > 0; --idx) {
+      if(!read_varint(position, end, value))
+        return false;
+      row -= (index_t) value;
+      col[idx - 1] = row;
+    }
+    return true;
+  }
+
+  // Moves position past a column without decoding its rows. Each row is a
+  // single varint, whose last byte is the only one with the high bit clear.
+  inline bool skip_column(const uint8_t*& position, const uint8_t* end) {
+    uint64_t value;
+    if(!read_varint(position, end, value))
+      return false;
+    const index_t n_rows = (index_t) value;
+    if(n_rows < 0 || n_rows > end - position)
+      return false;
+
+    for(index_t idx = 0; idx < n_rows; ++idx) {
+      while(position != end && (*position & 0x80))
+        ++position;
+      if(position == end)
+        return false;
+      ++position;
+    }
+    return true;
+  }
+
+
+  // Validated view of a compressed file that is already mapped in memory
+  class CompressedReader {
+  private:
+    CompressedHeader header;
+    const char* attributes;
+    const int64_t* block_offsets;
+    const uint8_t* payload;
+    DimensionIndex index;
+
+  public:
+    CompressedReader()
+      : header()
+      , attributes(nullptr)
+      , block_offsets(nullptr)
+      , payload(nullptr)
+      , index()
+    {}
+
+    bool attach(const MappedFile& file) {
+      if(!is_compressed_file(file))
+        return false;
+
+      memcpy(&header, file.begin(), sizeof(CompressedHeader));
+      if(header.version < 1 || header.version > compressed_version
+         || header.block_size == 0
+         || (header.attribute_bytes != 1 && header.attribute_bytes != 2
+             && header.attribute_bytes != 4 && header.attribute_bytes != 8)
+         || header.n_columns < 0 || header.n_entries < 0
+         || header.payload_bytes < 0
+         || header.n_blocks != (header.n_columns + header.block_size - 1)
+         / header.block_size)
+        return false;
+
+      const size_t n_columns = (size_t) header.n_columns;
+      const size_t attributes_size = n_columns * header.attribute_bytes;
+      const size_t attributes_start = sizeof(CompressedHeader);
+      const size_t offsets_start = attributes_start
+        + (attributes_size + sizeof(int64_t) - 1) / sizeof(int64_t) * sizeof(int64_t);
+      const size_t payload_start = offsets_start
+        + ((size_t) header.n_blocks + 1) * sizeof(int64_t);
+      if(payload_start + (size_t) header.payload_bytes > file.get_size())
+        return false;
+
+      attributes = file.begin() + attributes_start;
+      block_offsets = (const int64_t*) (file.begin() + offsets_start);
+      payload = (const uint8_t*) (file.begin() + payload_start);
+
+      if(block_offsets[0] != 0 || block_offsets[header.n_blocks] != header.payload_bytes)
+        return false;
+      for(int64_t block = 0; block < header.n_blocks; ++block) {
+        if(block_offsets[block] > block_offsets[block + 1])
+          return false;
+      }
+
+      if(header.version == 1) {
+        index.build(get_n_columns(), header.block_size,
+                    [&](index_t idx_col) { return get_attribute(idx_col); });
+        return true;
+      }
+      const size_t index_start = payload_start
+        + ((size_t) header.payload_bytes + sizeof(int64_t) - 1)
+        / sizeof(int64_t) * sizeof(int64_t);
+      return index_start <= file.get_size()
+        && index.read(file.begin() + index_start, file.end(), get_n_columns(),
+                      header.block_size);
+    }
+
+    index_t get_n_columns() const {
+      return (index_t) header.n_columns;
+    }
+
+    index_t get_n_entries() const {
+      return (index_t) header.n_entries;
+    }
+
+    index_t get_n_blocks() const {
+      return (index_t) header.n_blocks;
+    }
+
+    const DimensionIndex& get_dimension_index() const {
+      return index;
+    }
+
+    int64_t get_attribute(const index_t idx_col) const {
+      return read_packed_attribute(attributes + idx_col * header.attribute_bytes,
+                                   header.attribute_bytes);
+    }
+
+    index_t get_block_start(const index_t block) const {
+      return block * header.block_size;
+    }
+
+    index_t get_block_end(const index_t block) const {
+      return std::min((index_t) header.n_columns,
+                      (block + 1) * (index_t) header.block_size);
+    }
+
+    const uint8_t* block_begin(const index_t block) const {
+      return payload + block_offsets[block];
+    }
+
+    const uint8_t* block_end(const index_t block) const {
+      return payload + block_offsets[block + 1];
+    }
+
+    // Decodes the columns of the given block whose attribute lies in
+    // [min_dim, max_dim], calling visit(idx_col, attribute, col) with a
+    // column of type ColumnType. Other columns are skipped undecoded.
+    template<typename ColumnType, typename Visitor>
+    bool decode_block(const index_t block, const int64_t min_dim, const int64_t max_dim,
+                      ColumnType& col, Visitor visit) const {
+      const uint8_t* position = block_begin(block);
+      const uint8_t* end = block_end(block);
+      for(index_t idx_col = get_block_start(block);
+          idx_col < get_block_end(block); ++idx_col) {
+        const int64_t att = get_attribute(idx_col);
+        if(att < min_dim || att > max_dim) {
+          if(!skip_column(position, end))
+            return false;
+          continue;
+        }
+        if(!read_column(position, end, idx_col, col))
+          return false;
+        visit(idx_col, att, col);
+      }
+      return true;
+    }
+
+  };
+
+
+  // Decodes the blocks holding a column whose attribute lies in
+  // [min_dim, max_dim], in parallel when OpenMP is enabled. Other columns are
+  // left empty, attributes are read for every column.
+  template<typename ColumnType, typename AttributeType>
+  bool load_compressed_columns(const MappedFile& file,
+                               std::vector<ColumnType>& columns,
+                               std::vector<AttributeType>& attributes,
+                               const int64_t min_dim, const int64_t max_dim) {
+    CompressedReader reader;
+    if(!reader.attach(file))
+      return false;
+
+    const index_t n_columns = reader.get_n_columns();
+    const index_t n_blocks = reader.get_n_blocks();
+    const DimensionIndex& index = reader.get_dimension_index();
+    columns.clear();
+    columns.resize(n_columns);
+    attributes.resize(n_columns);
+    for(index_t idx_col = 0; idx_col < n_columns; ++idx_col)
+      attributes[idx_col] = (AttributeType) reader.get_attribute(idx_col);
+
+    bool valid = true;
+    #pragma omp parallel for schedule(dynamic) reduction(&&: valid)
+    for(index_t block = 0; block < n_blocks; ++block) {
+      if(!index.intersects(block, min_dim, max_dim))
+        continue;
+
+      const uint8_t* position = reader.block_begin(block);
+      const uint8_t* end = reader.block_end(block);
+      for(index_t idx_col = reader.get_block_start(block);
+          valid && idx_col < reader.get_block_end(block); ++idx_col) {
+        const int64_t att = reader.get_attribute(idx_col);
+        if(att >= min_dim && att <= max_dim)
+          valid = read_column(position, end, idx_col, columns[idx_col]);
+        else
+          valid = skip_column(position, end);
+      }
+    }
+    return valid;
+  }
+
+  template<typename ColumnType, typename AttributeType>
+  bool load_compressed_columns(const MappedFile& file,
+                               std::vector<ColumnType>& columns,
+                               std::vector<AttributeType>& attributes) {
+    return load_compressed_columns(file, columns, attributes,
+                                   std::numeric_limits<int64_t>::min(),
+                                   std::numeric_limits<int64_t>::max());
+  }
+
+  // Encodes blocks in parallel when OpenMP is enabled, then writes them in order
+  template<typename Matrix, typename AttributeType>
+  bool save_compressed_columns(const std::string& filename, const Matrix& matrix,
+                               const std::vector<AttributeType>& attributes) {
+    std::ofstream output_stream(filename.c_str(),
+                                std::ios_base::binary | std::ios_base::out);
+    if(output_stream.fail())
+      return false;
+
+    const index_t n_columns = matrix.get_n_columns();
+    const index_t block_size = compressed_block_size;
+    const index_t n_blocks = (n_columns + block_size - 1) / block_size;
+
+    std::vector<std::vector<uint8_t>> blocks(n_blocks);
+    #pragma omp parallel for schedule(dynamic)
+    for(index_t block = 0; block < n_blocks; ++block) {
+      const index_t end = std::min(n_columns, (block + 1) * block_size);
+      for(index_t idx_col = block * block_size; idx_col < end; ++idx_col)
+        append_column(blocks[block], idx_col,
+                      matrix.column_begin(idx_col), matrix.column_end(idx_col));
+    }
+
+    std::vector<int64_t> block_offsets(n_blocks + 1, 0);
+    int64_t n_entries = 0;
+    for(index_t block = 0; block < n_blocks; ++block)
+      block_offsets[block + 1] = block_offsets[block] + (int64_t) blocks[block].size();
+    for(index_t idx_col = 0; idx_col < n_columns; ++idx_col)
+      n_entries += (int64_t) (matrix.column_end(idx_col) - matrix.column_begin(idx_col));
+
+    CompressedHeader header;
+    memset(&header, 0, sizeof(CompressedHeader));
+    memcpy(header.magic, compressed_magic, sizeof(compressed_magic));
+    header.version = compressed_version;
+    header.block_size = compressed_block_size;
+    header.attribute_bytes = sizeof(AttributeType);
+    header.n_columns = n_columns;
+    header.n_entries = n_entries;
+    header.n_blocks = n_blocks;
+    header.payload_bytes = block_offsets[n_blocks];
+    output_stream.write((const char*) &header, sizeof(CompressedHeader));
+
+    const size_t attributes_size = n_columns * sizeof(AttributeType);
+    const size_t padded_size = (attributes_size + sizeof(int64_t) - 1)
+      / sizeof(int64_t) * sizeof(int64_t);
+    output_stream.write((const char*) attributes.data(), attributes_size);
+    const char padding[sizeof(int64_t)] = {0};
+    output_stream.write(padding, padded_size - attributes_size);
+
+    output_stream.write((const char*) block_offsets.data(),
+                        block_offsets.size() * sizeof(int64_t));
+    for(index_t block = 0; block < n_blocks; ++block) {
+      output_stream.write((const char*) blocks[block].data(), blocks[block].size());
+      std::vector<uint8_t>().swap(blocks[block]);
+    }
+    const size_t payload_size = (size_t) header.payload_bytes;
+    output_stream.write(padding, (payload_size + sizeof(int64_t) - 1)
+                        / sizeof(int64_t) * sizeof(int64_t) - payload_size);
+
+    DimensionIndex index;
+    index.build(n_columns, block_size,
+                [&](index_t idx_col) { return (int64_t) attributes[idx_col]; });
+    index.write(output_stream);
+
+    output_stream.close();
+    return !output_stream.fail();
+  }
+
+} // namespace stn
@@ -0,0 +1,128 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include <cstring>
+
+#include "commons.hpp"
+
+namespace stn {
+
+  // Per-dimension index stored at the end of binary files from version 2 on:
+  //   n_dimensions  int64_t
+  //   n_columns     n_dimensions int64_t, number of columns of each dimension
+  //   block_size    int64_t
+  //   n_blocks      int64_t
+  //   block_masks   n_blocks uint64_t, bit min(dim, 63) is set when the block
+  //                 holds a column of dimension dim
+  // A block is a run of block_size consecutive columns in file order, so that
+  // readers can skip every block without a column of the requested dimensions.
+  static const index_t dimension_block_size = 4096;
+
+  class DimensionIndex {
+  private:
+    std::vector<int64_t> n_columns_per_dimension;
+    int64_t block_size;
+    std::vector<uint64_t> block_masks;
+
+    static uint64_t dimension_bit(const int64_t dim) {
+      return (uint64_t) 1 << std::min<int64_t>(std::max<int64_t>(dim, 0), 63);
+    }
+
+  public:
+    DimensionIndex()
+      : n_columns_per_dimension()
+      , block_size(dimension_block_size)
+      , block_masks()
+    {}
+
+    // dimension_of(idx_col) gives the dimension of each of the n_columns columns
+    template<typename DimensionOf>
+    void build(const index_t n_columns, const index_t block_size_in,
+               DimensionOf dimension_of) {
+      block_size = block_size_in;
+      n_columns_per_dimension.clear();
+      block_masks.assign((n_columns + block_size - 1) / block_size, 0);
+
+      for(index_t idx_col = 0; idx_col < n_columns; ++idx_col) {
+        const int64_t dim = dimension_of(idx_col);
+        if(dim >= 0) {
+          if(dim >= (int64_t) n_columns_per_dimension.size())
+            n_columns_per_dimension.resize(dim + 1, 0);
+          ++n_columns_per_dimension[dim];
+        }
+        block_masks[idx_col / block_size] |= dimension_bit(dim);
+      }
+    }
+
+    // Parses an index starting at begin that must end before end
+    bool read(const char* begin, const char* end, const index_t n_columns,
+              const index_t expected_block_size) {
+      const int64_t* position = (const int64_t*) begin;
+      const int64_t* last = (const int64_t*) begin + (end - begin) / sizeof(int64_t);
+      if(last - position < 1 || position[0] < 0 || last - position - 1 < position[0])
+        return false;
+
+      const int64_t n_dimensions = *position++;
+      n_columns_per_dimension.assign(position, position + n_dimensions);
+      position += n_dimensions;
+
+      if(last - position < 2)
+        return false;
+      block_size = position[0];
+      const int64_t n_blocks = position[1];
+      position += 2;
+      if(block_size != expected_block_size
+         || n_blocks != (n_columns + block_size - 1) / block_size
+         || last - position < n_blocks)
+        return false;
+
+      block_masks.resize(n_blocks);
+      memcpy(block_masks.data(), position, n_blocks * sizeof(uint64_t));
+      return true;
+    }
+
+    void write(std::ostream& output_stream) const {
+      const int64_t n_dimensions = n_columns_per_dimension.size();
+      const int64_t n_blocks = block_masks.size();
+      output_stream.write((const char*) &n_dimensions, sizeof(int64_t));
+      output_stream.write((const char*) n_columns_per_dimension.data(),
+                          n_dimensions * sizeof(int64_t));
+      output_stream.write((const char*) &block_size, sizeof(int64_t));
+      output_stream.write((const char*) &n_blocks, sizeof(int64_t));
+      output_stream.write((const char*) block_masks.data(),
+                          n_blocks * sizeof(uint64_t));
+    }
+
+    dimension_t get_n_dimensions() const {
+      return (dimension_t) n_columns_per_dimension.size();
+    }
+
+    index_t get_n_columns(const dimension_t dim) const {
+      return dim < get_n_dimensions() ? n_columns_per_dimension[dim] : 0;
+    }
+
+    index_t get_block_size() const {
+      return block_size;
+    }
+
+    index_t get_n_blocks() const {
+      return (index_t) block_masks.size();
+    }
+
+    // Whether the block may hold a column of dimension in [min_dim, max_dim]
+    bool intersects(const index_t block, const int64_t min_dim,
+                    const int64_t max_dim) const {
+      if(min_dim > max_dim)
+        return false;
+      const uint64_t low = dimension_bit(min_dim);
+      const uint64_t high = dimension_bit(max_dim);
+      const uint64_t range = (high - low) | high;
+      return (block_masks[block] & range) != 0;
+    }
+
+  };
+
+} // namespace stn
@@ -0,0 +1,362 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+
+#include "commons.hpp"
+#include "mapped_file.hpp"
+#include "ascii_reader.hpp"
+#include "ascii_writer.hpp"
+#include "binary_format.hpp"
+#include "dimension_index.hpp"
+
+namespace stn {
+
+  // Anti-transposes a boundary matrix file into another one without holding
+  // either matrix in memory. The output is the same as BoundaryMatrix::dualize
+  // followed by save_ascii or save_binary. The input is streamed twice:
+  //   1. the dimensions and the number of entries per bin of rows are collected,
+  //      and bins are grouped into buckets of at most memory_budget bytes,
+  //   2. every entry is appended as a (row, column) pair to the run file of
+  //      the bucket covering its row. Buckets are filled a group at a time,
+  //      one pass over the input per group, so that the group buffers fit
+  //      in memory_budget and its run files can stay open.
+  // Buckets are then read back one at a time from the highest rows down,
+  // sorted and written out as dual columns. Besides one bucket, only the
+  // dimensions and the bin counts are kept in memory. A bin holding more
+  // entries than the budget makes up a bucket of its own.
+  class ExternalDualizer {
+  private:
+    struct Entry {
+      int64_t row;
+      int64_t col;
+    };
+
+    static const int bin_shift = 10;
+    // Smallest buffer worth a write, and most run files open at once
+    static const index_t min_buffer_entries = 1 << 10;
+    static const index_t max_open_runs = 256;
+
+    const size_t memory_budget;
+    const std::string run_prefix;
+
+    index_t n_columns;
+    index_t n_entries;
+    dimension_t n_dimensions;
+    std::vector<dimension_t> dimensions;
+    std::vector<index_t> bin_counts;
+    std::vector<index_t> bin_buckets;
+    std::vector<index_t> bucket_bins;
+    index_t n_passes;
+
+    std::string get_run_filename(const index_t bucket) const {
+      return run_prefix + std::to_string(bucket);
+    }
+
+    index_t get_n_buckets() const {
+      return (index_t) bucket_bins.size() - 1;
+    }
+
+    index_t get_n_bucket_entries(const index_t bucket) const {
+      index_t n_bucket_entries = 0;
+      for(index_t bin = bucket_bins[bucket]; bin < bucket_bins[bucket + 1]; ++bin)
+        n_bucket_entries += bin_counts[bin];
+      return n_bucket_entries;
+    }
+
+    void remove_runs() const {
+      for(index_t bucket = 0; bucket < get_n_buckets(); ++bucket)
+        std::remove(get_run_filename(bucket).c_str());
+    }
+
+    // Calls visit(idx_col, dim, rows, n_rows) on every column of the input
+    template<typename Visitor>
+    static bool scan_input(const std::string& filename, const bool use_binary,
+                           Visitor visit) {
+      if(use_binary) {
+        MappedFile file;
+        return file.open(filename) && scan_binary(file, visit);
+      }
+
+      AsciiReader reader;
+      if(!reader.open(filename))
+        return false;
+
+      index_t attribute;
+      std::vector<index_t> col;
+      for(index_t idx_col = 0; reader.next_column(attribute, col); ++idx_col)
+        visit(idx_col, attribute, col.data(), (int64_t) col.size());
+      return !reader.fail();
+    }
+
+    bool collect_statistics(const std::string& filename, const bool use_binary) {
+      bool valid = true;
+      dimensions.clear();
+      bin_counts.clear();
+      n_entries = 0;
+      index_t max_row = -1;
+      valid = scan_input(filename, use_binary,
+        [&](index_t /* idx_col */, int64_t dim, const int64_t* rows, int64_t n_rows) {
+          dimensions.push_back((dimension_t) dim);
+          for(int64_t idx = 0; idx < n_rows; ++idx) {
+            if(rows[idx] < 0) {
+              valid = false;
+              return;
+            }
+            const size_t bin = (size_t) (rows[idx] >> bin_shift);
+            if(bin >= bin_counts.size())
+              bin_counts.resize(bin + 1, 0);
+            ++bin_counts[bin];
+            max_row = std::max(max_row, (index_t) rows[idx]);
+          }
+          n_entries += n_rows;
+        }) && valid;
+
+      n_columns = dimensions.size();
+      if(!valid || max_row >= n_columns)
+        return false;
+
+      n_dimensions = 0;
+      for(dimension_t dim : dimensions)
+        n_dimensions = std::max(n_dimensions, (dimension_t) (dim + 1));
+
+      bin_counts.resize(((n_columns - 1) >> bin_shift) + 1, 0);
+      return true;
+    }
+
+    // Groups consecutive bins greedily, so that each bucket fits in the budget
+    void plan_buckets() {
+      const index_t capacity = std::max<index_t>(1, memory_budget / sizeof(Entry));
+      const index_t n_bins = bin_counts.size();
+
+      bin_buckets.resize(n_bins);
+      bucket_bins.assign(1, 0);
+      index_t size = 0;
+      for(index_t bin = 0; bin < n_bins; ++bin) {
+        if(size > 0 && size + bin_counts[bin] > capacity) {
+          bucket_bins.push_back(bin);
+          size = 0;
+        }
+        size += bin_counts[bin];
+        bin_buckets[bin] = get_n_buckets();
+      }
+      bucket_bins.push_back(n_bins);
+    }
+
+    bool distribute_entries(const std::string& filename, const bool use_binary) {
+      const index_t n_buckets = get_n_buckets();
+      index_t group_size = std::max<index_t>(1,
+        memory_budget / (sizeof(Entry) * min_buffer_entries));
+      if(group_size > max_open_runs)
+        group_size = max_open_runs;
+
+      bool valid = true;
+      n_passes = 0;
+      for(index_t group_begin = 0; valid && group_begin < n_buckets;
+          group_begin += group_size) {
+        const index_t group_end = std::min(n_buckets, group_begin + group_size);
+        const index_t buffer_size = std::max<index_t>(1,
+          memory_budget / sizeof(Entry) / (group_end - group_begin));
+        std::vector<std::vector<Entry>> buffers(group_end - group_begin);
+        std::vector<std::ofstream> run_streams(group_end - group_begin);
+        for(index_t bucket = group_begin; bucket < group_end; ++bucket) {
+          buffers[bucket - group_begin].reserve(
+            std::min(buffer_size, get_n_bucket_entries(bucket)));
+          // Entries are already buffered, so they are written straight through
+          std::ofstream& run_stream = run_streams[bucket - group_begin];
+          run_stream.rdbuf()->pubsetbuf(nullptr, 0);
+          run_stream.open(get_run_filename(bucket).c_str(),
+                          std::ios_base::binary | std::ios_base::out);
+          valid = valid && !run_stream.fail();
+        }
+
+        auto flush = [&](const index_t idx) {
+          run_streams[idx].write((const char*) buffers[idx].data(),
+                                 buffers[idx].size() * sizeof(Entry));
+          valid = valid && !run_streams[idx].fail();
+          buffers[idx].clear();
+        };
+
+        valid = valid && scan_input(filename, use_binary,
+          [&](index_t idx_col, int64_t /* dim */, const int64_t* rows, int64_t n_rows) {
+            for(int64_t idx = 0; idx < n_rows; ++idx) {
+              const index_t bucket = bin_buckets[rows[idx] >> bin_shift];
+              if(bucket < group_begin || bucket >= group_end)
+                continue;
+              std::vector<Entry>& buffer = buffers[bucket - group_begin];
+              buffer.push_back(Entry{rows[idx], idx_col});
+              if((index_t) buffer.size() >= buffer_size)
+                flush(bucket - group_begin);
+            }
+          });
+
+        for(index_t idx = 0; idx < group_end - group_begin; ++idx) {
+          if(!buffers[idx].empty())
+            flush(idx);
+          run_streams[idx].close();
+          valid = valid && !run_streams[idx].fail();
+        }
+        ++n_passes;
+      }
+      return valid;
+    }
+
+    // Calls visit(idx_col, dim, col) on every dual column, in order
+    template<typename Visitor>
+    bool merge_buckets(Visitor visit) {
+      std::vector<Entry> entries;
+      std::vector<index_t> dual_col;
+      for(index_t bucket = get_n_buckets() - 1; bucket >= 0; --bucket) {
+        const index_t n_bucket_entries = get_n_bucket_entries(bucket);
+        entries.resize(n_bucket_entries);
+        std::ifstream run_stream(get_run_filename(bucket).c_str(),
+                                 std::ios_base::binary | std::ios_base::in);
+        run_stream.read((char*) entries.data(), n_bucket_entries * sizeof(Entry));
+        if(run_stream.fail())
+          return false;
+        run_stream.close();
+        std::remove(get_run_filename(bucket).c_str());
+
+        std::sort(entries.begin(), entries.end(),
+                  [](const Entry& a, const Entry& b) {
+                    return a.row > b.row || (a.row == b.row && a.col > b.col);
+                  });
+
+        const index_t row_begin = bucket_bins[bucket] << bin_shift;
+        const index_t row_end = std::min(n_columns, bucket_bins[bucket + 1] << bin_shift);
+        index_t position = 0;
+        for(index_t row = row_end - 1; row >= row_begin; --row) {
+          dual_col.clear();
+          for(; position < n_bucket_entries && entries[position].row == row; ++position)
+            dual_col.push_back(n_columns - 1 - entries[position].col);
+          visit(n_columns - 1 - row,
+                (dimension_t) (n_dimensions - 1 - dimensions[row]), dual_col);
+        }
+      }
+      return true;
+    }
+
+    bool write_ascii(const std::string& output_filename) {
+      AsciiWriter writer;
+      if(!writer.open(output_filename))
+        return false;
+
+      bool valid = merge_buckets(
+        [&](index_t /* idx_col */, dimension_t dim, const std::vector<index_t>& col) {
+          writer.put_index(dim);
+          for(index_t row : col) {
+            writer.put(' ');
+            writer.put_index(row);
+          }
+          writer.put('\n');
+          writer.flush_if_full();
+        });
+      return writer.close() && valid;
+    }
+
+    // Offsets and rows are streamed to their own sections of the CSR layout
+    bool write_binary(const std::string& output_filename) {
+      std::fstream output_stream(output_filename.c_str(), std::ios_base::binary
+                                 | std::ios_base::out | std::ios_base::trunc);
+      if(output_stream.fail())
+        return false;
+
+      BinaryHeader header;
+      memset(&header, 0, sizeof(BinaryHeader));
+      memcpy(header.magic, binary_magic, sizeof(binary_magic));
+      header.version = binary_version;
+      header.index_bytes = sizeof(int64_t);
+      header.attribute_bytes = sizeof(dimension_t);
+      header.n_columns = n_columns;
+      header.n_entries = n_entries;
+      output_stream.write((const char*) &header, sizeof(BinaryHeader));
+
+      std::vector<dimension_t> dual_dimensions(n_columns);
+      for(index_t idx_col = 0; idx_col < n_columns; ++idx_col)
+        dual_dimensions[n_columns - 1 - idx_col] = n_dimensions - 1 - dimensions[idx_col];
+      const size_t attributes_size = n_columns * sizeof(dimension_t);
+      output_stream.write((const char*) dual_dimensions.data(), attributes_size);
+      const char padding[sizeof(int64_t)] = {0};
+      output_stream.write(padding, binary_padded_size(attributes_size) - attributes_size);
+
+      const int64_t offsets_start = output_stream.tellp();
+      const int64_t rows_start = offsets_start + (n_columns + 1) * sizeof(int64_t);
+      int64_t offset = 0;
+      output_stream.write((const char*) &offset, sizeof(int64_t));
+
+      std::vector<int64_t> offsets;
+      std::vector<int64_t> rows;
+      auto flush = [&](const index_t idx_col_end) {
+        output_stream.seekp(offsets_start
+                            + (idx_col_end + 2 - offsets.size()) * sizeof(int64_t));
+        output_stream.write((const char*) offsets.data(), offsets.size() * sizeof(int64_t));
+        output_stream.seekp(rows_start + (offset - rows.size()) * sizeof(int64_t));
+        output_stream.write((const char*) rows.data(), rows.size() * sizeof(int64_t));
+        offsets.clear();
+        rows.clear();
+      };
+
+      const size_t buffer_size = 1 << 19;
+      bool valid = merge_buckets(
+        [&](index_t idx_col, dimension_t /* dim */, const std::vector<index_t>& col) {
+          rows.insert(rows.end(), col.begin(), col.end());
+          offset += col.size();
+          offsets.push_back(offset);
+          if(rows.size() + offsets.size() >= buffer_size)
+            flush(idx_col);
+        });
+      flush(n_columns - 1);
+
+      output_stream.seekp(rows_start + n_entries * sizeof(int64_t));
+      DimensionIndex index;
+      index.build(n_columns, dimension_block_size,
+                  [&](index_t idx_col) { return (int64_t) dual_dimensions[idx_col]; });
+      index.write(output_stream);
+
+      output_stream.close();
+      return valid && offset == n_entries && !output_stream.fail();
+    }
+
+  public:
+    // Run files are named run_prefix followed by the bucket number
+    ExternalDualizer(const size_t memory_budget_in, const std::string& run_prefix_in)
+      : memory_budget(memory_budget_in)
+      , run_prefix(run_prefix_in)
+      , n_columns(0)
+      , n_entries(0)
+      , n_dimensions(0)
+      , dimensions()
+      , bin_counts()
+      , bin_buckets()
+      , bucket_bins()
+      , n_passes(0)
+    {}
+
+    bool dualize(const std::string& input_filename, const std::string& output_filename,
+                 const bool use_binary) {
+      if(!collect_statistics(input_filename, use_binary))
+        return false;
+
+      plan_buckets();
+      bool valid = distribute_entries(input_filename, use_binary)
+        && (use_binary ? write_binary(output_filename) : write_ascii(output_filename));
+      remove_runs();
+      return valid;
+    }
+
+    index_t get_n_buckets_used() const {
+      return get_n_buckets();
+    }
+
+    // Passes over the input that distributed the entries to the buckets
+    index_t get_n_passes_used() const {
+      return n_passes;
+    }
+
+  };
+
+} // namespace stn
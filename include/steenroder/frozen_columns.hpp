@@ -0,0 +1,153 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "commons.hpp"
+#include "column_span.hpp"
+#include "thread_local_storage.h"
+
+namespace stn {
+
+  // Read only columns packed into 64 bit words, for matrices that are done
+  // being reduced and are only read back in order. A non empty column takes
+  //   (n_rows << 8) | width
+  //   max_row
+  //   the n_rows - 1 gaps between consecutive rows minus one, from the
+  //   largest row down, each on width bits
+  // where width is the number of bits of the largest gap, so that runs of
+  // consecutive rows take no payload at all. Empty columns take no word.
+  template<typename IndexType>
+  class FrozenColumns {
+  private:
+    std::vector<uint64_t> words;
+    std::vector<index_t> offsets;
+    mutable thread_local_storage<std::vector<IndexType>> decode_buffer;
+
+    static unsigned get_width(uint64_t value) {
+      unsigned width = 0;
+      while(value) {
+        ++width;
+        value >>= 1;
+      }
+      return width;
+    }
+
+    void append_bits(index_t& bit_position, const uint64_t value, const unsigned width) {
+      if(!width)
+        return;
+      const index_t idx_word = bit_position >> 6;
+      const unsigned shift = bit_position & 63;
+      if(idx_word == (index_t) words.size())
+        words.push_back(0);
+      words[idx_word] |= value << shift;
+      if(shift + width > 64)
+        words.push_back(value >> (64 - shift));
+      bit_position += width;
+    }
+
+  public:
+    FrozenColumns()
+      : words()
+      , offsets(1, 0)
+      , decode_buffer()
+    {}
+
+    index_t get_n_columns() const {
+      return offsets.size() - 1;
+    }
+
+    // Bytes taken by the packed columns and their offsets
+    size_t get_n_bytes() const {
+      return words.size() * sizeof(uint64_t) + offsets.size() * sizeof(index_t);
+    }
+
+    // Columns must be appended in order and be strictly increasing
+    template<typename Column>
+    void append(const Column& col) {
+      const index_t n_rows = col.size();
+      if(n_rows) {
+        uint64_t max_gap = 0;
+        for(index_t idx = 1; idx < n_rows; ++idx)
+          max_gap = std::max<uint64_t>(max_gap, col[idx] - col[idx - 1] - 1);
+        const unsigned width = get_width(max_gap);
+
+        words.push_back(((uint64_t) n_rows << 8) | width);
+        words.push_back((uint64_t) col[n_rows - 1]);
+        index_t bit_position = (index_t) words.size() << 6;
+        for(index_t idx = n_rows - 1; idx > 0; --idx)
+          append_bits(bit_position, col[idx] - col[idx - 1] - 1, width);
+      }
+      offsets.push_back(words.size());
+    }
+
+    void shrink_to_fit() {
+      words.shrink_to_fit();
+      offsets.shrink_to_fit();
+    }
+
+    index_t get_n_rows(const index_t idx) const {
+      return offsets[idx] == offsets[idx + 1] ? 0 : words[offsets[idx]] >> 8;
+    }
+
+    bool is_empty(const index_t idx) const {
+      return get_n_rows(idx) == 0;
+    }
+
+    index_t get_max_index(const index_t idx) const {
+      return is_empty(idx) ? -1 : (index_t) words[offsets[idx] + 1];
+    }
+
+    // Decodes column idx to col from the largest row down
+    template<typename Column>
+    void get_column(const index_t idx, Column& col) const {
+      const index_t n_rows = get_n_rows(idx);
+      col.resize(n_rows);
+      if(!n_rows)
+        return;
+
+      const uint64_t* word = &words[offsets[idx]];
+      const unsigned width = word[0] & 0xff;
+      const uint64_t mask = width == 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << width) - 1;
+      IndexType row = (IndexType) word[1];
+      col[n_rows - 1] = row;
+
+      word += 2;
+      unsigned shift = 0;
+      for(index_t idx_row = n_rows - 2; idx_row >= 0; --idx_row) {
+        uint64_t gap = 0;
+        if(width) {
+          gap = *word >> shift;
+          if(shift + width > 64)
+            gap |= word[1] << (64 - shift);
+          shift += width;
+          if(shift >= 64) {
+            shift -= 64;
+            ++word;
+          }
+        }
+        row -= (IndexType) (gap & mask) + 1;
+        col[idx_row] = row;
+      }
+    }
+
+    // Decoded column, valid until the next call to get_span on this thread
+    ColumnSpan<IndexType> get_span(const index_t idx) const {
+      std::vector<IndexType>& col = decode_buffer();
+      get_column(idx, col);
+      return make_span(col);
+    }
+
+    // The words of the column are not reclaimed, it only reads as empty
+    void clear(const index_t idx) {
+      if(!is_empty(idx))
+        words[offsets[idx]] &= 0xff;
+    }
+
+  };
+
+} // namespace stn
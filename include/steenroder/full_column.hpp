@@ -0,0 +1,71 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include "commons.hpp"
+#include "abstract_pivot_column.hpp"
+
+namespace stn {
+
+  // Dense bitset of the rows, with a max-heap of every row flipped since the
+  // column was last emptied. Flipping a row costs one bit and at most one
+  // push, and the largest row is found by dropping the unset rows from the
+  // top of the heap.
+  class FullPivotColumn
+    : public AbstractPivotColumn<FullPivotColumn> {
+  private:
+    std::vector<char> is_set;
+    std::vector<char> is_in_history;
+    std::vector<index_t> history;
+
+  public:
+    FullPivotColumn()
+      : is_set()
+      , is_in_history()
+      , history()
+    {}
+
+    void init(const index_t n_rows) {
+      is_set.assign(n_rows, 0);
+      is_in_history.assign(n_rows, 0);
+      history.clear();
+    }
+
+    index_t get_max_index() {
+      while(!history.empty()) {
+        const index_t max_index = history.front();
+        if(is_set[max_index])
+          return max_index;
+        std::pop_heap(history.begin(), history.end());
+        history.pop_back();
+        is_in_history[max_index] = 0;
+      }
+      return -1;
+    }
+
+    bool is_empty() {
+      return get_max_index() == -1;
+    }
+
+    void add_index(const index_t row) {
+      is_set[row] ^= 1;
+      if(!is_in_history[row]) {
+        is_in_history[row] = 1;
+        history.push_back(row);
+        std::push_heap(history.begin(), history.end());
+      }
+    }
+
+    void clear() {
+      for(index_t row : history) {
+        is_set[row] = 0;
+        is_in_history[row] = 0;
+      }
+      history.clear();
+    }
+
+  };
+
+} // namespace stn
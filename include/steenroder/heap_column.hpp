@@ -0,0 +1,98 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include "commons.hpp"
+#include "abstract_pivot_column.hpp"
+
+namespace stn {
+
+  // Max-heap of rows in which pairs of equal rows cancel lazily: adding a
+  // column only pushes its rows and duplicates are dropped when they reach
+  // the top. The heap is rebuilt without duplicates once more rows were
+  // pushed since the last rebuild than it holds.
+  class HeapPivotColumn
+    : public AbstractPivotColumn<HeapPivotColumn> {
+  private:
+    std::vector<index_t> heap;
+    index_t n_pushes_since_prune;
+    std::vector<index_t> pruned;
+
+    void push(const index_t row) {
+      heap.push_back(row);
+      std::push_heap(heap.begin(), heap.end());
+    }
+
+    void pop() {
+      std::pop_heap(heap.begin(), heap.end());
+      heap.pop_back();
+    }
+
+    void prune() {
+      get_col_and_clear(pruned);
+      heap.assign(pruned.begin(), pruned.end());
+      std::make_heap(heap.begin(), heap.end());
+      n_pushes_since_prune = 0;
+    }
+
+  public:
+    HeapPivotColumn()
+      : heap()
+      , n_pushes_since_prune(0)
+      , pruned()
+    {}
+
+    void init(const index_t /* n_rows */) {
+      heap.clear();
+      n_pushes_since_prune = 0;
+    }
+
+    // Cancels the pairs at the top, so that it holds a row that is set
+    index_t get_max_index() {
+      while(!heap.empty()) {
+        const index_t max_index = heap.front();
+        pop();
+        if(heap.empty() || heap.front() != max_index) {
+          push(max_index);
+          return max_index;
+        }
+        pop();
+      }
+      return -1;
+    }
+
+    index_t pop_max_index() {
+      const index_t max_index = get_max_index();
+      if(max_index != -1)
+        pop();
+      return max_index;
+    }
+
+    bool is_empty() {
+      return get_max_index() == -1;
+    }
+
+    void add_index(const index_t row) {
+      push(row);
+      ++n_pushes_since_prune;
+    }
+
+    template<typename Column>
+    void add_col(const Column& col) {
+      for(typename Column::const_iterator row = col.begin(); row != col.end(); ++row)
+        push(*row);
+      n_pushes_since_prune += col.size();
+      if(2 * n_pushes_since_prune > (index_t) heap.size())
+        prune();
+    }
+
+    void clear() {
+      heap.clear();
+      n_pushes_since_prune = 0;
+    }
+
+  };
+
+} // namespace stn
@@ -7,6 +7,7 @@
 #include "commons.hpp"
 #include "sorted_matrix.hpp"
 #include "sorted_bars.hpp"
+#include "matrix_vector.hpp"
 #include "reduction.hpp"
 
 namespace stn {
@@ -25,7 +26,26 @@ namespace stn {
     void compute(ViewFiniteBars<ColumnType>& finite_bars,
                  ViewInfiniteBars<ColumnType>& infinite_bars) {
       reduction(finite_bars, infinite_bars);
+      set_bars(finite_bars, infinite_bars);
+    }
+
+    // Reduces the columns of finite_bars moved into finite_blocks one
+    // dimension at a time, then gathers them back to set the bars
+    template<typename ColumnType = VectorColumn>
+    void compute(MatrixVector<ColumnType>& finite_blocks,
+                 ViewFiniteBars<ColumnType>& finite_bars,
+                 ViewInfiniteBars<ColumnType>& infinite_bars) {
+      MatrixVector<ColumnType> infinite_blocks = MatrixVector<ColumnType>::identity(finite_blocks);
+      reduction(finite_blocks, infinite_blocks);
+      finite_blocks.gather(finite_bars);
+      infinite_blocks.gather(infinite_bars);
+      set_bars(finite_bars, infinite_bars);
+    }
 
+  private:
+    template<typename ColumnType>
+    void set_bars(ViewFiniteBars<ColumnType>& finite_bars,
+                  ViewInfiniteBars<ColumnType>& infinite_bars) {
       const index_t n_columns = finite_bars.get_n_columns();
       std::vector<bool> infinite(n_columns, true);
       for(index_t idx_col = 0; idx_col < n_columns; ++idx_col) {
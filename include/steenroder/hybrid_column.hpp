@@ -0,0 +1,153 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include "commons.hpp"
+#include "abstract_pivot_column.hpp"
+#include "bit_tree_column.hpp"
+#include "sparse_column.hpp"
+
+namespace stn {
+
+  // Pivot column that starts as a sorted sparse column and moves to a bit
+  // tree once an addition would take it past promotion_threshold rows, as
+  // merging then costs more than flipping the rows of each added column. It
+  // goes back to sparse once it has shrunk to a quarter of that. Most
+  // columns stay small and never leave the sparse representation, while the
+  // few that fill in are added to in place. The bit tree spans every row,
+  // so it is only allocated the first time a column is promoted.
+  template<typename ColumnType>
+  class HybridPivotColumn
+    : public AbstractPivotColumn<HybridPivotColumn<ColumnType>> {
+  private:
+    enum { promotion_threshold = 16 };
+
+    SparsePivotColumn<ColumnType> sparse_col;
+    BitTreePivotColumn dense_col;
+    bool is_dense;
+    bool is_allocated;
+    index_t n_rows;
+    index_t n_dense_rows;
+    ColumnType temp_col;
+
+    void allocate_dense() {
+      if(!is_allocated) {
+        dense_col.init(n_rows);
+        is_allocated = true;
+      }
+    }
+
+    void promote() {
+      allocate_dense();
+      sparse_col.get_col_and_clear(temp_col);
+      dense_col.add_col(temp_col);
+      n_dense_rows = temp_col.size();
+      is_dense = true;
+    }
+
+    void demote() {
+      dense_col.get_col_and_clear(temp_col);
+      sparse_col.set_col(temp_col);
+      is_dense = false;
+    }
+
+  public:
+    HybridPivotColumn()
+      : sparse_col()
+      , dense_col()
+      , is_dense(false)
+      , is_allocated(false)
+      , n_rows(0)
+      , n_dense_rows(0)
+      , temp_col()
+    {}
+
+    void init(const index_t n_rows_in) {
+      sparse_col.init(n_rows_in);
+      dense_col = BitTreePivotColumn();
+      is_dense = false;
+      is_allocated = false;
+      n_rows = n_rows_in;
+      n_dense_rows = 0;
+    }
+
+    index_t get_max_index() const {
+      return is_dense ? dense_col.get_max_index() : sparse_col.get_max_index();
+    }
+
+    bool is_empty() const {
+      return is_dense ? dense_col.is_empty() : sparse_col.is_empty();
+    }
+
+    void add_index(const index_t row) {
+      if(is_dense) {
+        n_dense_rows += dense_col.contains(row) ? -1 : 1;
+        dense_col.add_index(row);
+      } else {
+        sparse_col.add_index(row);
+      }
+    }
+
+    // Promotes before merging a sum that may be large, and demotes after
+    // an addition that left few rows
+    template<typename Column>
+    void add_col(const Column& col) {
+      if(!is_dense && (index_t) (sparse_col.size() + col.size()) > promotion_threshold)
+        promote();
+
+      if(!is_dense) {
+        sparse_col.add_col(col);
+        return;
+      }
+
+      for(typename Column::const_iterator row = col.begin(); row != col.end(); ++row)
+        add_index(*row);
+      if(4 * n_dense_rows < promotion_threshold)
+        demote();
+    }
+
+    index_t pop_max_index() {
+      if(!is_dense)
+        return sparse_col.pop_max_index();
+
+      const index_t max_index = dense_col.pop_max_index();
+      if(max_index != -1)
+        --n_dense_rows;
+      return max_index;
+    }
+
+    template<typename Column>
+    void get_col_and_clear(Column& col) {
+      if(is_dense) {
+        dense_col.get_col_and_clear(col);
+        is_dense = false;
+      } else {
+        sparse_col.get_col_and_clear(col);
+      }
+    }
+
+    void clear() {
+      if(is_dense)
+        dense_col.clear();
+      sparse_col.clear();
+      is_dense = false;
+    }
+
+    template<typename Column>
+    void set_col(const Column& col) {
+      clear();
+      if((index_t) col.size() > promotion_threshold) {
+        allocate_dense();
+        dense_col.add_col(col);
+        n_dense_rows = col.size();
+        is_dense = true;
+      } else {
+        sparse_col.set_col(col);
+      }
+    }
+
+  };
+
+} // namespace stn
@@ -0,0 +1,130 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include "commons.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+  #define STN_HAS_MMAP
+#endif
+
+namespace stn {
+
+  // Read-only view of a whole file. The file is memory-mapped when the
+  // platform supports it and read into a private buffer otherwise.
+  class MappedFile {
+  private:
+    const char* data;
+    size_t size;
+    void* mapping;
+    std::vector<char> buffer;
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool read_buffer(const std::string& filename) {
+      std::ifstream input_stream(filename.c_str(),
+                                 std::ios_base::binary | std::ios_base::in);
+      if(input_stream.fail())
+        return false;
+
+      input_stream.seekg(0, std::ios_base::end);
+      std::streamoff n_bytes = input_stream.tellg();
+      input_stream.seekg(0, std::ios_base::beg);
+      if(n_bytes < 0)
+        return false;
+
+      buffer.resize((size_t) n_bytes);
+      if(n_bytes > 0)
+        input_stream.read(buffer.data(), n_bytes);
+      if(input_stream.fail())
+        return false;
+
+      data = buffer.data();
+      size = buffer.size();
+      return true;
+    }
+
+  public:
+    MappedFile()
+      : data(nullptr)
+      , size(0)
+      , mapping(nullptr)
+      , buffer()
+    {}
+
+    ~MappedFile() {
+      close();
+    }
+
+    // Hints the kernel for a single front to back pass unless sequential is
+    // unset, in which case the default read-ahead policy is kept.
+    bool open(const std::string& filename, const bool sequential = true) {
+      close();
+
+#ifdef STN_HAS_MMAP
+      int fd = ::open(filename.c_str(), O_RDONLY);
+      if(fd == -1)
+        return false;
+
+      struct stat file_stat;
+      if(fstat(fd, &file_stat) == -1) {
+        ::close(fd);
+        return false;
+      }
+
+      size = (size_t) file_stat.st_size;
+      if(size == 0) {
+        ::close(fd);
+        return true;
+      }
+
+      void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if(address == MAP_FAILED) {
+        size = 0;
+        return read_buffer(filename);
+      }
+
+      if(sequential)
+        madvise(address, size, MADV_SEQUENTIAL);
+      mapping = address;
+      data = (const char*) address;
+      return true;
+#else
+      return read_buffer(filename);
+#endif
+    }
+
+    void close() {
+#ifdef STN_HAS_MMAP
+      if(mapping != nullptr)
+        munmap(mapping, size);
+#endif
+      mapping = nullptr;
+      data = nullptr;
+      size = 0;
+      std::vector<char>().swap(buffer);
+    }
+
+    const char* begin() const {
+      return data;
+    }
+
+    const char* end() const {
+      return data + size;
+    }
+
+    size_t get_size() const {
+      return size;
+    }
+
+  };
+
+} // namespace stn
@@ -0,0 +1,189 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include "commons.hpp"
+#include "vector_column.hpp"
+#include "column_span.hpp"
+#include "mapped_file.hpp"
+#include "binary_format.hpp"
+#include "ascii_writer.hpp"
+
+namespace stn {
+
+  // Read-only ViewMatrix whose columns live in a memory-mapped CSR file.
+  // Columns are paged in lazily and shared through the page cache between
+  // processes reading the same file; only the view is kept on the heap.
+  template<typename ColumnType = VectorColumn>
+  class MappedViewMatrix {
+  private:
+    static_assert(sizeof(index_t) == sizeof(int64_t),
+                  "CSR files of all versions store 64 bit row indices");
+
+    MappedFile file;
+    CsrReader reader;
+
+  protected:
+    std::vector<index_t> view;
+    dimension_t n_dimensions;
+    std::vector<index_t> n_columns_per_dimension;
+    std::vector<index_t> start_dimension;
+
+    // Same ordering as ViewMatrix::create_view, by counting sort
+    void create_view() {
+      const index_t n_columns = get_n_columns();
+
+      n_dimensions = 0;
+      for(index_t idx_col = 0; idx_col < n_columns; ++idx_col)
+        n_dimensions = std::max(n_dimensions,
+                                (dimension_t) (reader.get_attribute(idx_col) + 1));
+
+      n_columns_per_dimension.assign(n_dimensions, 0);
+      for(index_t idx_col = 0; idx_col < n_columns; ++idx_col)
+        ++n_columns_per_dimension[reader.get_attribute(idx_col)];
+
+      start_dimension.assign(n_dimensions, 0);
+      for(dimension_t dim = 1; dim < n_dimensions; ++dim)
+        start_dimension[dim] = start_dimension[dim-1] + n_columns_per_dimension[dim-1];
+
+      std::vector<index_t> position(start_dimension);
+      view.resize(n_columns);
+      for(index_t idx_col = 0; idx_col < n_columns; ++idx_col)
+        view[position[reader.get_attribute(idx_col)]++] = idx_col;
+    }
+
+  public:
+    MappedViewMatrix()
+      : file()
+      , reader()
+      , view()
+      , n_dimensions(0)
+      , n_columns_per_dimension()
+      , start_dimension()
+    {}
+
+    // Only files in the CSR layout can be mapped
+    bool load_binary(std::string filename) {
+      if(!file.open(filename, false) || !reader.attach(file))
+        return false;
+
+      for(index_t idx_col = 0; idx_col < get_n_columns(); ++idx_col) {
+        if(reader.get_attribute(idx_col) < 0)
+          return false;
+      }
+
+      create_view();
+      return true;
+    }
+
+    index_t get_n_columns() const {
+      return reader.get_n_columns();
+    }
+
+    const index_t* column_begin(const index_t idx) const {
+      return reader.column_begin(idx);
+    }
+
+    const index_t* column_end(const index_t idx) const {
+      return reader.column_end(idx);
+    }
+
+    ColumnSpan<index_t> get_span(const index_t idx) const {
+      return ColumnSpan<index_t>(column_begin(idx), column_end(idx));
+    }
+
+    template<typename Column>
+    void get_column(const index_t idx, Column& col) const {
+      col.assign(column_begin(idx), column_end(idx));
+    }
+
+    bool is_empty(const index_t idx) const {
+      return column_begin(idx) == column_end(idx);
+    }
+
+    index_t get_max_index(const index_t idx) const {
+      return is_empty(idx) ? -1 : *(column_end(idx) - 1);
+    }
+
+    index_t get_n_rows(const index_t idx) const {
+      return column_end(idx) - column_begin(idx);
+    }
+
+    index_t get_n_entries() const {
+      return reader.get_n_entries();
+    }
+
+    dimension_t get_n_dimensions() const {
+      return n_dimensions;
+    }
+
+    const std::vector<index_t>& get_n_columns_per_dimension() const {
+      return n_columns_per_dimension;
+    }
+
+    index_t get_n_columns_per_dimension(const dimension_t dim) const {
+      return n_columns_per_dimension[dim];
+    }
+
+    const std::vector<index_t>& get_start_dimension() const {
+      return start_dimension;
+    }
+
+    index_t get_start_dimension(const dimension_t dim) const {
+      return start_dimension[dim];
+    }
+
+    index_t get_view(const index_t idx_view) const {
+      return view[idx_view];
+    }
+
+    const std::vector<index_t>& get_view() const {
+      return view;
+    }
+
+    // Format: each line represents a column, first number is attribute, other numbers are the content of the column
+    bool save_ascii(const std::string& name, const std::string& output_filename) const {
+      std::string filename = output_filename + "_" + name + ".dat";
+      AsciiWriter writer;
+      if(!writer.open(filename))
+        return false;
+
+      for(dimension_t dim = 0; dim < n_dimensions; ++dim) {
+        writer.put("# dim ");
+        writer.put_index(dim);
+        writer.put('\n');
+
+        index_t start = start_dimension[dim];
+        index_t end = start + n_columns_per_dimension[dim];
+        writer.write_range(start, end,
+          [&](AsciiBuffer& buffer, index_t begin_view, index_t end_view) {
+            for(index_t view_idx = begin_view; view_idx < end_view; ++view_idx) {
+              buffer.put_index(view[view_idx]);
+              buffer.put(' ');
+              buffer.put_list(column_begin(view[view_idx]), column_end(view[view_idx]));
+              buffer.put('\n');
+            }
+          });
+      }
+
+      return writer.close();
+    }
+
+    // The mapping already is in the CSR layout, so it is written back as is
+    bool save_binary(const std::string& name, const std::string& output_filename) const {
+      std::string filename = output_filename + "_" + name + ".dat";
+      std::ofstream output_stream(filename.c_str(),
+                                  std::ios_base::binary | std::ios_base::out);
+      if(output_stream.fail())
+        return false;
+
+      output_stream.write(file.begin(), file.get_size());
+      output_stream.close();
+      return !output_stream.fail();
+    }
+
+  };
+
+} // namespace stn
@@ -5,45 +5,165 @@
 #pragma once
 
 #include "commons.hpp"
+#include "sparse_matrix.hpp"
+#include "sorted_matrix.hpp"
+#include "vector_column.hpp"
 
 namespace stn {
 
-  template<class Matrix>
+  // Columns of a ViewMatrix stored in one matrix per dimension, so that the
+  // columns of a dimension are contiguous and a reduction walking them does
+  // not jump across the columns of the others. Columns keep their global
+  // index as row indices and are found from it through the global to local
+  // index map.
+  template<typename ColumnType = VectorColumn>
   class MatrixVector {
+  public:
+    using column_index_t = typename SparseMatrix<ColumnType>::column_index_t;
+
   private:
-    std::vector<Matrix> matrix_vector;
+    std::vector<SparseMatrix<ColumnType>> matrix_vector;
+    std::vector<std::vector<column_index_t>> global_indices;
+    std::vector<dimension_t> dimensions;
+    std::vector<column_index_t> local_indices;
 
-    void break_down(Matrix& matrix) {
-      index_t n_columns = matrix.get_n_columns();
-      dimension_t n_matrices = matrix.get_max_dimension();
+    // Lays out the columns of each dimension in the order of the view
+    void create_layout(const ViewMatrix<ColumnType>& view_matrix) {
+      const index_t n_columns = view_matrix.get_n_columns();
+      const dimension_t n_dimensions = view_matrix.get_n_dimensions();
+      matrix_vector.resize(n_dimensions);
+      global_indices.resize(n_dimensions);
+      dimensions.resize(n_columns);
+      local_indices.resize(n_columns);
 
-      for(dimension_t dimension = 0; dimension < n_matrices; ++dimension){
-        matrix_vector[dimension].set_n_columns(n_columns);
+      for(dimension_t dim = 0; dim < n_dimensions; ++dim) {
+        const index_t start = view_matrix.get_start_dimension(dim);
+        const index_t n_dim_columns = view_matrix.get_n_columns_per_dimension(dim);
+        matrix_vector[dim].set_n_columns(n_dim_columns);
+        global_indices[dim].resize(n_dim_columns);
+        for(index_t idx_local = 0; idx_local < n_dim_columns; ++idx_local) {
+          const index_t idx_col = view_matrix.get_view(start + idx_local);
+          global_indices[dim][idx_local] = idx_col;
+          dimensions[idx_col] = dim;
+          local_indices[idx_col] = idx_local;
+        }
       }
+    }
 
-      dimension_t dimension;
-      column temp_col;
-      std::vector<index_t> indices(n_matrices, 0);
-      for(index_t col = 0; col < n_columns; ++col) {
-        dimension = simplex_matrix.get_dimension(idx_cur_col);
-        matrix.get_column(col, temp_col);
+  public:
+    MatrixVector()
+      : matrix_vector()
+      , global_indices()
+      , dimensions()
+      , local_indices()
+    {}
 
-        matrix_vector[dimension].set_dimension(indices[dimension],
-                                               n_columns - 1 - col);
-        matrix_vector[dimension].set_column(indices[dimension], temp_col);
+    MatrixVector(const ViewMatrix<ColumnType>& view_matrix_in)
+      : MatrixVector()
+    {
+      create_layout(view_matrix_in);
 
-        ++indices[dimension];
+      ColumnType temp_col;
+      for(dimension_t dim = 0; dim < get_n_dimensions(); ++dim) {
+        for(index_t idx_local = 0; idx_local < get_n_columns(dim); ++idx_local) {
+          view_matrix_in.get_column(global_indices[dim][idx_local], temp_col);
+          matrix_vector[dim].set_column(idx_local, temp_col);
+        }
       }
+    }
+
+    // Moves the columns of view_matrix_in, which are left empty while its
+    // view is kept to gather them back. Each column is swapped out of
+    // view_matrix_in and into its block, so it is never stored twice.
+    MatrixVector(ViewMatrix<ColumnType>&& view_matrix_in)
+      : MatrixVector()
+    {
+      create_layout(view_matrix_in);
 
-      for(dimension_t dimension = 0; dimension < n_matrices; ++dimension){
-        matrix_vector[dimension].set_n_columns(indices[dimension]);
+      SparseMatrix<ColumnType>& sparse_matrix_in = view_matrix_in;
+      ColumnType temp_col;
+      for(dimension_t dim = 0; dim < get_n_dimensions(); ++dim) {
+        for(index_t idx_local = 0; idx_local < get_n_columns(dim); ++idx_local) {
+          sparse_matrix_in.swap_column(global_indices[dim][idx_local], temp_col);
+          matrix_vector[dim].swap_column(idx_local, temp_col);
+        }
       }
     }
 
-  public:
-    MatrixVector(Matrix& matrix)
-    {
-      break_down(matrix);
+    // Identity matrix with the layout of matrix_in, without storing any
+    // column
+    static MatrixVector identity(const MatrixVector& matrix_in) {
+      MatrixVector matrix;
+      matrix.matrix_vector.resize(matrix_in.get_n_dimensions());
+      matrix.global_indices = matrix_in.global_indices;
+      matrix.dimensions = matrix_in.dimensions;
+      matrix.local_indices = matrix_in.local_indices;
+      for(dimension_t dim = 0; dim < matrix.get_n_dimensions(); ++dim)
+        matrix.matrix_vector[dim].set_identity(matrix.global_indices[dim]);
+      return matrix;
+    }
+
+    // Writes the columns back to view_matrix, which must have the layout
+    // this was built from. Columns it already holds are not rewritten.
+    void gather(ViewMatrix<ColumnType>& view_matrix) const {
+      ColumnType temp_col;
+      for(dimension_t dim = 0; dim < get_n_dimensions(); ++dim) {
+        for(index_t idx_local = 0; idx_local < get_n_columns(dim); ++idx_local) {
+          const index_t idx_col = global_indices[dim][idx_local];
+          if(view_matrix.get_span(idx_col).equals(matrix_vector[dim].get_span(idx_local)))
+            continue;
+          matrix_vector[dim].get_column(idx_local, temp_col);
+          view_matrix.set_column(idx_col, temp_col);
+        }
+      }
+    }
+
+    dimension_t get_n_dimensions() const {
+      return matrix_vector.size();
+    }
+
+    index_t get_n_columns() const {
+      return dimensions.size();
+    }
+
+    index_t get_n_columns(const dimension_t dim) const {
+      return matrix_vector[dim].get_n_columns();
+    }
+
+    SparseMatrix<ColumnType>& get_matrix(const dimension_t dim) {
+      return matrix_vector[dim];
+    }
+
+    const SparseMatrix<ColumnType>& get_matrix(const dimension_t dim) const {
+      return matrix_vector[dim];
+    }
+
+    dimension_t get_dimension(const index_t idx_col) const {
+      return dimensions[idx_col];
+    }
+
+    index_t get_local_index(const index_t idx_col) const {
+      return local_indices[idx_col];
+    }
+
+    index_t get_global_index(const dimension_t dim, const index_t idx_local) const {
+      return global_indices[dim][idx_local];
+    }
+
+    ColumnSpan<column_index_t> get_span(const index_t idx_col) const {
+      return matrix_vector[dimensions[idx_col]].get_span(local_indices[idx_col]);
+    }
+
+    bool is_empty(const index_t idx_col) const {
+      return matrix_vector[dimensions[idx_col]].is_empty(local_indices[idx_col]);
+    }
+
+    index_t get_max_index(const index_t idx_col) const {
+      return matrix_vector[dimensions[idx_col]].get_max_index(local_indices[idx_col]);
+    }
+
+    void clear(const index_t idx_col) {
+      matrix_vector[dimensions[idx_col]].clear(local_indices[idx_col]);
     }
 
   };
@@ -7,25 +7,73 @@
 #include "commons.hpp"
 #include "boundary_matrix.hpp"
 #include "sorted_matrix.hpp"
+#include "matrix_vector.hpp"
+#include "hybrid_column.hpp"
 
 namespace stn {
 
-  template<typename ColumnType = VectorColumn>
+  // Reduces one column of a boundary matrix together with the same column of
+  // its triangular matrix. Both are loaded into pivot columns of type
+  // PivotColumn, which any of SparsePivotColumn, BitTreePivotColumn,
+  // HeapPivotColumn, FullPivotColumn and HybridPivotColumn can be, and only
+  // written back once the pivot is new.
+  template<typename ColumnType, typename PivotColumn>
+  class ColumnReducer {
+  private:
+    PivotColumn boundary_col;
+    PivotColumn triangular_col;
+    ColumnType result;
+
+  public:
+    void init(const index_t n_rows) {
+      boundary_col.init(n_rows);
+      triangular_col.init(n_rows);
+    }
+
+    // Returns the pivot of the reduced column, or -1 when it is zero. The
+    // reduction stops early once the pivot is below min_pivot, and entries
+    // of pivot_lookup below min_pivot are not read.
+    template<typename MatrixType>
+    index_t operator()(MatrixType& boundary_matrix, MatrixType& triangular_matrix,
+                       const index_t idx_col,
+                       const std::vector<typename ColumnType::value_type>& pivot_lookup,
+                       const index_t min_pivot = 0) {
+      index_t pivot = boundary_matrix.get_max_index(idx_col);
+      if(pivot < min_pivot || pivot_lookup[pivot] == -1)
+        return pivot;
+
+      boundary_col.set_col(boundary_matrix.get_span(idx_col));
+      triangular_col.set_col(triangular_matrix.get_span(idx_col));
+      while(pivot >= min_pivot && pivot_lookup[pivot] != -1) {
+        boundary_col.add_col(boundary_matrix.get_span(pivot_lookup[pivot]));
+        triangular_col.add_col(triangular_matrix.get_span(pivot_lookup[pivot]));
+        pivot = boundary_col.get_max_index();
+      }
+
+      boundary_col.get_col_and_clear(result);
+      boundary_matrix.set_column(idx_col, result);
+      triangular_col.get_col_and_clear(result);
+      triangular_matrix.set_column(idx_col, result);
+      return pivot;
+    }
+  };
+
+
+  template<typename ColumnType = VectorColumn,
+           typename PivotColumn = HybridPivotColumn<ColumnType>>
   class StandardReduction {
   public:
     void operator()(BoundaryMatrix<ColumnType>& boundary_matrix,
                     BoundaryMatrix<ColumnType>& triangular_matrix) {
       const index_t n_columns = boundary_matrix.get_n_columns();
       triangular_matrix.set_n_columns(n_columns);
-      std::vector<index_t> pivot_lookup(n_columns, -1);
+      std::vector<typename ColumnType::value_type> pivot_lookup(n_columns, -1);
+      ColumnReducer<ColumnType, PivotColumn> reduce_column;
+      reduce_column.init(n_columns);
 
       for(index_t idx_col = 0; idx_col < n_columns; ++idx_col) {
-        index_t pivot = boundary_matrix.get_max_index(idx_col);
-        while(pivot != -1 && pivot_lookup[pivot] != -1) {
-          boundary_matrix.add(pivot_lookup[pivot], idx_col);
-          triangular_matrix.add(pivot_lookup[pivot], idx_col);
-          pivot = boundary_matrix.get_max_index(idx_col);
-        }
+        index_t pivot = reduce_column(boundary_matrix, triangular_matrix,
+                                      idx_col, pivot_lookup);
         if(pivot != -1) {
           pivot_lookup[pivot] = idx_col;
         }
@@ -34,13 +82,16 @@ namespace stn {
   };
 
 
-  template<typename ColumnType = VectorColumn>
+  template<typename ColumnType = VectorColumn,
+           typename PivotColumn = HybridPivotColumn<ColumnType>>
   class TwistReduction {
   public:
     void operator()(ViewMatrix<ColumnType>& boundary_matrix,
                     ViewMatrix<ColumnType>& triangular_matrix ) {
       const index_t n_columns = boundary_matrix.get_n_columns();
-      std::vector< index_t > pivot_lookup(n_columns, -1);
+      std::vector<typename ColumnType::value_type> pivot_lookup(n_columns, -1);
+      ColumnReducer<ColumnType, PivotColumn> reduce_column;
+      reduce_column.init(n_columns);
 
       // for(dimension_t dim = boundary_matrix.get_n_dimensions() - 1; dim >= 1 ; --dim) {
       for(dimension_t dim = 0; dim < boundary_matrix.get_n_dimensions() - 1; ++dim) {
@@ -48,12 +99,8 @@ namespace stn {
         index_t end = start + boundary_matrix.get_n_columns_per_dimension(dim);
         for(index_t view_idx = start; view_idx < end; ++view_idx) {
           index_t col_idx = boundary_matrix.get_view(view_idx);
-          index_t pivot = boundary_matrix.get_max_index(col_idx);
-          while(pivot != -1 && pivot_lookup[pivot] != -1) {
-            boundary_matrix.add(pivot_lookup[pivot], col_idx);
-            triangular_matrix.add(pivot_lookup[pivot], col_idx);
-            pivot = boundary_matrix.get_max_index(col_idx);
-          }
+          index_t pivot = reduce_column(boundary_matrix, triangular_matrix,
+                                        col_idx, pivot_lookup);
 
           if(pivot != -1) {
             pivot_lookup[pivot] = col_idx;
@@ -62,6 +109,183 @@ namespace stn {
         }
       }
     }
+
+    // Same reduction walking the contiguous columns of each dimension. The
+    // columns added to a column all have its dimension, so pivot_lookup
+    // holds their local index.
+    void operator()(MatrixVector<ColumnType>& boundary_matrix,
+                    MatrixVector<ColumnType>& triangular_matrix) {
+      const index_t n_columns = boundary_matrix.get_n_columns();
+      std::vector<typename ColumnType::value_type> pivot_lookup(n_columns, -1);
+      ColumnReducer<ColumnType, PivotColumn> reduce_column;
+      reduce_column.init(n_columns);
+
+      for(dimension_t dim = 0; dim < boundary_matrix.get_n_dimensions() - 1; ++dim) {
+        SparseMatrix<ColumnType>& boundary_block = boundary_matrix.get_matrix(dim);
+        SparseMatrix<ColumnType>& triangular_block = triangular_matrix.get_matrix(dim);
+        const index_t n_dim_columns = boundary_matrix.get_n_columns(dim);
+        for(index_t idx_local = 0; idx_local < n_dim_columns; ++idx_local) {
+          index_t pivot = reduce_column(boundary_block, triangular_block,
+                                        idx_local, pivot_lookup);
+
+          if(pivot != -1) {
+            pivot_lookup[pivot] = idx_local;
+            boundary_matrix.clear(pivot);
+          }
+        }
+      }
+    }
+  };
+
+
+  // Chunk reduction of PHAT. The columns of each dimension are split into
+  // chunks that are reduced in parallel, each only as far as the pivots
+  // owned by its own columns allow: a column paired there is final, since
+  // the owner of a pivot comes after it. A second parallel pass does the
+  // same over pairs of consecutive chunks, and the remaining columns are
+  // then reduced in order. Columns are added in the same order as with
+  // TwistReduction, so both reduce to the same matrices.
+  template<typename ColumnType = VectorColumn,
+           typename PivotColumn = HybridPivotColumn<ColumnType>>
+  class ChunkReduction {
+  private:
+    typedef ColumnReducer<ColumnType, PivotColumn> Reducer;
+
+    // Chunks take uneven times to reduce, so each thread gets several of
+    // them to balance the dynamic schedule
+    static const index_t chunks_per_thread = 4;
+
+    // Offsets of the first column of each chunk of a dimension, followed by
+    // n_dim_columns
+    static std::vector<index_t> get_chunk_offsets(const index_t n_dim_columns) {
+      const index_t chunk_size = std::max<index_t>(1, omp_get_max_threads() == 1
+        ? (index_t) std::sqrt((double) n_dim_columns)
+        : n_dim_columns / (chunks_per_thread * omp_get_max_threads()));
+
+      std::vector<index_t> chunk_offsets;
+      for(index_t offset = 0; offset < n_dim_columns; offset += chunk_size)
+        chunk_offsets.push_back(offset);
+      chunk_offsets.push_back(n_dim_columns);
+      return chunk_offsets;
+    }
+
+    // Runs the passes over the chunks of a dimension. reduce_chunk(begin,
+    // end, min_pivot) reduces the columns at offsets [begin, end) and
+    // get_min_pivot(offset) is the smallest pivot the columns from offset
+    // on can own.
+    template<typename ReduceChunk, typename MinPivot>
+    static void reduce_dimension(const index_t n_dim_columns, ReduceChunk reduce_chunk,
+                                 MinPivot get_min_pivot) {
+      const std::vector<index_t> chunk_offsets = get_chunk_offsets(n_dim_columns);
+      const index_t n_chunks = chunk_offsets.size() - 1;
+      std::vector<index_t> chunk_min_pivots(n_chunks);
+      for(index_t chunk = 0; chunk < n_chunks; ++chunk)
+        chunk_min_pivots[chunk] = get_min_pivot(chunk_offsets[chunk]);
+
+      // The arena appends to a pool shared by all its columns, so its
+      // chunks are reduced one after the other
+      #pragma omp parallel for schedule(dynamic, 1) if(ConcurrentColumnWrites<ColumnType>::value)
+      for(index_t chunk = 0; chunk < n_chunks; ++chunk)
+        reduce_chunk(chunk_offsets[chunk], chunk_offsets[chunk + 1],
+                     chunk_min_pivots[chunk]);
+
+      #pragma omp parallel for schedule(dynamic, 1) if(ConcurrentColumnWrites<ColumnType>::value)
+      for(index_t chunk = 1; chunk < n_chunks; ++chunk)
+        reduce_chunk(chunk_offsets[chunk], chunk_offsets[chunk + 1],
+                     chunk_min_pivots[chunk - 1]);
+
+      reduce_chunk(0, n_dim_columns, 0);
+    }
+
+    // Reduces the columns of the view in [begin, end) whose pivot is at
+    // least min_pivot and pairs those whose pivot stays there. Of the other
+    // chunks, only columns that are already paired are read.
+    static void reduce_chunk(ViewMatrix<ColumnType>& boundary_matrix,
+                             ViewMatrix<ColumnType>& triangular_matrix,
+                             std::vector<typename ColumnType::value_type>& pivot_lookup,
+                             Reducer& reduce_column, const index_t begin,
+                             const index_t end, const index_t min_pivot) {
+      for(index_t view_idx = begin; view_idx < end; ++view_idx) {
+        index_t col_idx = boundary_matrix.get_view(view_idx);
+        index_t pivot = boundary_matrix.get_max_index(col_idx);
+        if(pivot < min_pivot || pivot_lookup[pivot] == col_idx)
+          continue;
+
+        pivot = reduce_column(boundary_matrix, triangular_matrix,
+                              col_idx, pivot_lookup, min_pivot);
+        if(pivot >= min_pivot) {
+          pivot_lookup[pivot] = col_idx;
+          boundary_matrix.clear(pivot);
+        }
+      }
+    }
+
+    // Same for the columns in [begin, end) of the block of dimension dim,
+    // with pivot_lookup holding local indices as in TwistReduction
+    static void reduce_chunk(MatrixVector<ColumnType>& boundary_matrix,
+                             MatrixVector<ColumnType>& triangular_matrix,
+                             std::vector<typename ColumnType::value_type>& pivot_lookup,
+                             Reducer& reduce_column, const dimension_t dim,
+                             const index_t begin, const index_t end,
+                             const index_t min_pivot) {
+      SparseMatrix<ColumnType>& boundary_block = boundary_matrix.get_matrix(dim);
+      SparseMatrix<ColumnType>& triangular_block = triangular_matrix.get_matrix(dim);
+      for(index_t idx_local = begin; idx_local < end; ++idx_local) {
+        index_t pivot = boundary_block.get_max_index(idx_local);
+        if(pivot < min_pivot || pivot_lookup[pivot] == idx_local)
+          continue;
+
+        pivot = reduce_column(boundary_block, triangular_block,
+                              idx_local, pivot_lookup, min_pivot);
+        if(pivot >= min_pivot) {
+          pivot_lookup[pivot] = idx_local;
+          boundary_matrix.clear(pivot);
+        }
+      }
+    }
+
+  public:
+    void operator()(ViewMatrix<ColumnType>& boundary_matrix,
+                    ViewMatrix<ColumnType>& triangular_matrix) {
+      const index_t n_columns = boundary_matrix.get_n_columns();
+      std::vector<typename ColumnType::value_type> pivot_lookup(n_columns, -1);
+      thread_local_storage<Reducer> reducers;
+      for(int tid = 0; tid < omp_get_max_threads(); ++tid)
+        reducers[tid].init(n_columns);
+
+      for(dimension_t dim = 0; dim < boundary_matrix.get_n_dimensions() - 1; ++dim) {
+        const index_t start = boundary_matrix.get_start_dimension(dim);
+        reduce_dimension(boundary_matrix.get_n_columns_per_dimension(dim),
+          [&](const index_t begin, const index_t end, const index_t min_pivot) {
+            reduce_chunk(boundary_matrix, triangular_matrix, pivot_lookup, reducers(),
+                         start + begin, start + end, min_pivot);
+          },
+          [&](const index_t offset) {
+            return (index_t) boundary_matrix.get_view(start + offset);
+          });
+      }
+    }
+
+    // Same reduction walking the contiguous columns of each dimension
+    void operator()(MatrixVector<ColumnType>& boundary_matrix,
+                    MatrixVector<ColumnType>& triangular_matrix) {
+      const index_t n_columns = boundary_matrix.get_n_columns();
+      std::vector<typename ColumnType::value_type> pivot_lookup(n_columns, -1);
+      thread_local_storage<Reducer> reducers;
+      for(int tid = 0; tid < omp_get_max_threads(); ++tid)
+        reducers[tid].init(n_columns);
+
+      for(dimension_t dim = 0; dim < boundary_matrix.get_n_dimensions() - 1; ++dim) {
+        reduce_dimension(boundary_matrix.get_n_columns(dim),
+          [&](const index_t begin, const index_t end, const index_t min_pivot) {
+            reduce_chunk(boundary_matrix, triangular_matrix, pivot_lookup, reducers(),
+                         dim, begin, end, min_pivot);
+          },
+          [&](const index_t offset) {
+            return boundary_matrix.get_global_index(dim, offset);
+          });
+      }
+    }
   };
 
 } // namespace stn
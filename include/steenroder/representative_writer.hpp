@@ -0,0 +1,190 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include <cstring>
+
+#include "commons.hpp"
+#include "mapped_file.hpp"
+#include "binary_format.hpp"
+#include "column_span.hpp"
+
+namespace stn {
+
+  // Representatives file (version 1), native endian:
+  //   header   magic, version, reserved, n_bars, index_offset
+  //   records  one per bar: int64_t dimension, birth, n_rows, then n_rows
+  //            int64_t rows
+  //   index    n_bars pairs of int64_t: byte offset of the record, death
+  // Records are appended as bars are produced. Deaths are only known at the
+  // end, so they live in the index written when the file is closed.
+  struct RepresentativeHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    int64_t n_bars;
+    int64_t index_offset;
+  };
+
+  static const char representative_magic[8] = {'S', 'T', 'N', 'R', 'E', 'P', '\0', '\0'};
+  static const uint32_t representative_version = 1;
+
+  class RepresentativeWriter {
+  private:
+    std::ofstream output_stream;
+    int64_t position;
+    std::vector<int64_t> index;
+    std::vector<int64_t> buffer;
+
+    RepresentativeWriter(const RepresentativeWriter&) = delete;
+    RepresentativeWriter& operator=(const RepresentativeWriter&) = delete;
+
+    void write_header(const int64_t n_bars, const int64_t index_offset) {
+      RepresentativeHeader header;
+      memset(&header, 0, sizeof(RepresentativeHeader));
+      memcpy(header.magic, representative_magic, sizeof(representative_magic));
+      header.version = representative_version;
+      header.n_bars = n_bars;
+      header.index_offset = index_offset;
+      output_stream.write((const char*) &header, sizeof(RepresentativeHeader));
+    }
+
+  public:
+    RepresentativeWriter()
+      : output_stream()
+      , position(0)
+      , index()
+      , buffer()
+    {}
+
+    bool open(const std::string& filename) {
+      output_stream.open(filename.c_str(), std::ios_base::binary | std::ios_base::out);
+      if(output_stream.fail())
+        return false;
+
+      index.clear();
+      write_header(0, 0);
+      position = sizeof(RepresentativeHeader);
+      return true;
+    }
+
+    bool is_open() const {
+      return output_stream.is_open();
+    }
+
+    // Appends a bar and returns its number in the file
+    template<typename ColumnType>
+    index_t write(const dimension_t dim, const index_t birth, const index_t death,
+                  const ColumnType& representative) {
+      const int64_t record[3] = {dim, birth, (int64_t) representative.size()};
+      output_stream.write((const char*) record, sizeof(record));
+      write_rows(output_stream, representative.data(),
+                 representative.data() + representative.size(), buffer);
+
+      index.push_back(position);
+      index.push_back(death);
+      position += sizeof(record) + representative.size() * sizeof(int64_t);
+      return (index_t) index.size() / 2 - 1;
+    }
+
+    void set_death(const index_t bar, const index_t death) {
+      index[2 * bar + 1] = death;
+    }
+
+    index_t get_n_bars() const {
+      return (index_t) index.size() / 2;
+    }
+
+    bool close() {
+      output_stream.write((const char*) index.data(), index.size() * sizeof(int64_t));
+      output_stream.seekp(0);
+      write_header(get_n_bars(), position);
+      output_stream.close();
+      return !output_stream.fail();
+    }
+
+  };
+
+
+  // Random access to the bars of a representatives file
+  class RepresentativeReader {
+  private:
+    MappedFile file;
+    RepresentativeHeader header;
+    const int64_t* index;
+
+    const int64_t* record(const index_t bar) const {
+      return (const int64_t*) (file.begin() + index[2 * bar]);
+    }
+
+  public:
+    RepresentativeReader()
+      : file()
+      , header()
+      , index(nullptr)
+    {}
+
+    bool open(const std::string& filename) {
+      if(!file.open(filename, false) || file.get_size() < sizeof(RepresentativeHeader)
+         || memcmp(file.begin(), representative_magic, sizeof(representative_magic)) != 0)
+        return false;
+
+      memcpy(&header, file.begin(), sizeof(RepresentativeHeader));
+      const size_t n_bytes = file.get_size();
+      if(header.version != representative_version || header.n_bars < 0
+         || header.index_offset < (int64_t) sizeof(RepresentativeHeader)
+         || (size_t) header.index_offset > n_bytes
+         || (n_bytes - header.index_offset) / (2 * sizeof(int64_t)) < (size_t) header.n_bars)
+        return false;
+
+      index = (const int64_t*) (file.begin() + header.index_offset);
+      for(index_t bar = 0; bar < header.n_bars; ++bar) {
+        const int64_t offset = index[2 * bar];
+        if(offset < (int64_t) sizeof(RepresentativeHeader)
+           || header.index_offset - offset < (int64_t) (3 * sizeof(int64_t)))
+          return false;
+        const int64_t n_rows = record(bar)[2];
+        if(n_rows < 0 || (header.index_offset - offset) / (int64_t) sizeof(int64_t) - 3 < n_rows)
+          return false;
+      }
+      return true;
+    }
+
+    index_t get_n_bars() const {
+      return (index_t) header.n_bars;
+    }
+
+    dimension_t get_dimension(const index_t bar) const {
+      return (dimension_t) record(bar)[0];
+    }
+
+    index_t get_birth(const index_t bar) const {
+      return record(bar)[1];
+    }
+
+    index_t get_death(const index_t bar) const {
+      return index[2 * bar + 1];
+    }
+
+    const int64_t* column_begin(const index_t bar) const {
+      return record(bar) + 3;
+    }
+
+    const int64_t* column_end(const index_t bar) const {
+      return record(bar) + 3 + record(bar)[2];
+    }
+
+    ColumnSpan<int64_t> get_span(const index_t bar) const {
+      return ColumnSpan<int64_t>(column_begin(bar), column_end(bar));
+    }
+
+    template<typename ColumnType>
+    void get_column(const index_t bar, ColumnType& col) const {
+      col.assign(column_begin(bar), column_end(bar));
+    }
+
+  };
+
+} // namespace stn
@@ -6,7 +6,10 @@
 
 #include "commons.hpp"
 #include "sorted_matrix.hpp"
+#include "mapped_matrix.hpp"
 #include "vector_column.hpp"
+#include "column_operations.hpp"
+#include "ascii_writer.hpp"
 
 namespace stn {
 
@@ -15,80 +18,99 @@ namespace stn {
   private:
     using Base = ViewMatrix<ColumnType>;
 
-    void build_simplex(ColumnType& simplex, const ColumnType& boundary,
+    // scratch holds the unions as they are built, so that adding a face does
+    // not allocate
+    template<typename BoundaryMatrixType, typename Boundary>
+    void build_simplex(VectorColumn& simplex, const Boundary& boundary,
                        const dimension_t dim,
-                       const ViewMatrix<ColumnType>& boundary_matrix) {
+                       const BoundaryMatrixType& boundary_matrix,
+                       VectorColumn& scratch) {
       if(dim == 1) {
-        simplex = boundary;
+        simplex.assign(boundary.begin(), boundary.end());
         return;
       }
 
-      VectorColumn temp;
       for(index_t idx_row = 0; idx_row < boundary.size(); ++idx_row) {
-        boundary_matrix.get_column(boundary[idx_row], temp);
-        simplex |= temp;
+        column_union(simplex, boundary_matrix.get_span(boundary[idx_row]), scratch);
+        simplex.swap(scratch);
       }
 
-      temp.clear();
-      build_simplex(temp, simplex, dim - 1, boundary_matrix);
+      VectorColumn temp;
+      build_simplex(temp, simplex, dim - 1, boundary_matrix, scratch);
     }
 
-    void init_simplices(const ViewMatrix<ColumnType>& boundary_matrix,
-                        const dimension_t dimension_d,
-                        const dimension_t dimension_d_k) {
-      VectorColumn simplex, boundary;
-
-      index_t start = boundary_matrix.get_start_dimension(dimension_d);
-      index_t end = start + boundary_matrix.get_n_columns_per_dimension(dimension_d);
-      for(index_t idx_view = start; idx_view < end; ++idx_view) {
-        index_t idx_col = boundary_matrix.get_view(idx_view);
-
-        ColumnType simplex;
-        boundary_matrix.get_column(idx_col, boundary);
-        build_simplex(simplex, boundary, dimension_d, boundary_matrix);
-        Base::set_column(idx_col, simplex);
-      }
+    template<typename BoundaryMatrixType>
+    void init_simplices(const BoundaryMatrixType& boundary_matrix,
+                        const dimension_t dimension) {
+      VectorColumn scratch;
 
-      start = boundary_matrix.get_start_dimension(dimension_d_k);
-      end = start + boundary_matrix.get_n_columns_per_dimension(dimension_d_k);
+      index_t start = boundary_matrix.get_start_dimension(dimension);
+      index_t end = start + boundary_matrix.get_n_columns_per_dimension(dimension);
       for(index_t idx_view = start; idx_view < end; ++idx_view) {
         index_t idx_col = boundary_matrix.get_view(idx_view);
 
-        ColumnType simplex;
-        boundary_matrix.get_column(idx_col, boundary);
-        build_simplex(simplex, boundary, dimension_d_k, boundary_matrix);
+        VectorColumn simplex;
+        build_simplex(simplex, boundary_matrix.get_span(idx_col), dimension,
+                      boundary_matrix, scratch);
         Base::set_column(idx_col, simplex);
       }
     }
 
 
   public:
+    // Takes over boundary_matrix_in and replaces its columns of dimensions d
+    // and d + k in place. Simplices are only built from the boundaries of
+    // lower dimensional cells, so those of dimension d + k come first while
+    // the columns of dimension d are still boundaries.
+    SimplexMatrix(ViewMatrix<ColumnType>&& boundary_matrix_in,
+                  const dimension_t dimension_d_in,
+                  const dimension_t dimension_d_k_in)
+      : Base(std::move(boundary_matrix_in))
+    {
+      init_simplices(*this, dimension_d_k_in);
+      if(dimension_d_in != dimension_d_k_in)
+        init_simplices(*this, dimension_d_in);
+    };
+
     SimplexMatrix(const ViewMatrix<ColumnType>& boundary_matrix_in,
                   const dimension_t dimension_d_in,
                   const dimension_t dimension_d_k_in)
-      : Base(boundary_matrix_in)
+      : SimplexMatrix(ViewMatrix<ColumnType>(boundary_matrix_in),
+                      dimension_d_in, dimension_d_k_in)
+    {};
+
+    // Only the columns of dimensions d and d + k are materialized, the
+    // boundary matrix itself stays in its mapping.
+    SimplexMatrix(const MappedViewMatrix<ColumnType>& boundary_matrix_in,
+                  const dimension_t dimension_d_in,
+                  const dimension_t dimension_d_k_in)
+      : Base(boundary_matrix_in.get_n_columns(),
+             boundary_matrix_in.get_n_dimensions())
     {
-      init_simplices(boundary_matrix_in, dimension_d_in, dimension_d_k_in);
+      for(index_t idx_view = 0; idx_view < boundary_matrix_in.get_n_columns(); ++idx_view)
+        Base::set_view(idx_view, boundary_matrix_in.get_view(idx_view));
+      Base::set_n_columns_per_dimension(boundary_matrix_in.get_n_columns_per_dimension());
+      Base::set_start_dimension(boundary_matrix_in.get_start_dimension());
+
+      init_simplices(boundary_matrix_in, dimension_d_in);
+      init_simplices(boundary_matrix_in, dimension_d_k_in);
     };
 
-    SimplexMatrix(const SimplexMatrix& other) {
-      *this = other;
-    }
+    SimplexMatrix(const SimplexMatrix& other)
+      : Base(other)
+    {}
 
     using Base::get_n_columns;
 
+    // Compares the candidate with the columns in place, without copying them
     index_t is_in(const index_t min_idx, const dimension_t dim,
-                  const VectorColumn& candidate) const {
-      VectorColumn temp_col;
+                  const ColumnType& candidate) const {
       index_t start = Base::get_start_dimension(dim);
       index_t end = start + Base::get_n_columns_per_dimension(dim);
       for(index_t idx_view = start; idx_view < end; ++idx_view) {
         index_t idx_col = Base::get_view(idx_view);
-        if(idx_col >= min_idx) {
-          Base::get_column(idx_col, temp_col);
-          if(temp_col == candidate) {
-            return idx_col;
-          }
+        if(idx_col >= min_idx && Base::get_span(idx_col).equals(candidate)) {
+          return idx_col;
         }
       }
       return -1;
@@ -96,28 +118,29 @@ namespace stn {
 
 
     // Format: each line represents a column, first number is attribute, other numbers are the content of the column
-    bool save_ascii(const std::string& name, const std::string& output_filename) {
+    bool save_ascii(const std::string& name, const std::string& output_filename) const {
       std::string filename = output_filename + "_" + name + ".dat";
-      std::ofstream output_stream(filename.c_str());
-      if(output_stream.fail())
+      AsciiWriter writer;
+      if(!writer.open(filename))
         return false;
 
-      VectorColumn temp_col;
-      //output_stream << "# dim " << (index_t) dimension << std::endl;
-
-      for(index_t col_idx =0; col_idx < Base::get_n_columns(); ++col_idx) {
-        Base::get_column(col_idx, temp_col);
-        for(index_t row_idx = 0; row_idx < (index_t) temp_col.size(); ++row_idx)
-          output_stream << " " << temp_col[row_idx];
-        output_stream << std::endl;
-      }
+      writer.write_range(0, Base::get_n_columns(),
+        [&](AsciiBuffer& buffer, index_t begin, index_t end) {
+          for(index_t col_idx = begin; col_idx < end; ++col_idx) {
+            for(const typename Base::column_index_t* row = Base::column_begin(col_idx);
+                row != Base::column_end(col_idx); ++row) {
+              buffer.put(' ');
+              buffer.put_index(*row);
+            }
+            buffer.put('\n');
+          }
+        });
 
-      output_stream.close();
-      return true;
+      return writer.close();
     }
 
     // Format: n_columns % att1 % N1 % row1 row2 % ...% rowN1 % att2 % N2 % ...
-    bool save_binary(const std::string& name, const std::string& output_filename) {
+    bool save_binary(const std::string& name, const std::string& output_filename) const {
       return true;
     }
 
@@ -0,0 +1,288 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include "commons.hpp"
+#include "column_operations.hpp"
+
+namespace stn {
+
+  // Sorted column of row indices that keeps up to n_inline of them in place
+  // and only moves to the heap past that. Boundaries of low dimensional cells
+  // and the singletons of the bars matrices then need no allocation. It has
+  // the part of the std::vector interface used by the matrices, readers and
+  // reductions, so it can be used as their ColumnType.
+  template<typename IndexType, size_t n_inline>
+  class BasicSmallColumn {
+  public:
+    typedef IndexType value_type;
+    typedef IndexType* iterator;
+    typedef const IndexType* const_iterator;
+    typedef size_t size_type;
+
+  private:
+    size_t n_rows;
+    size_t capacity;
+    union {
+      IndexType* heap;
+      IndexType local[n_inline];
+    };
+
+    bool is_inline() const {
+      return capacity == n_inline;
+    }
+
+    void release() {
+      if(!is_inline())
+        delete[] heap;
+    }
+
+    // Moves the entries to a heap block of new_capacity > n_inline entries
+    void reallocate(const size_t new_capacity) {
+      IndexType* new_heap = new IndexType[new_capacity];
+      std::copy(begin(), end(), new_heap);
+      release();
+      heap = new_heap;
+      capacity = new_capacity;
+    }
+
+    void take(BasicSmallColumn& other) {
+      n_rows = other.n_rows;
+      capacity = other.capacity;
+      if(other.is_inline())
+        std::copy(other.local, other.local + n_rows, local);
+      else
+        heap = other.heap;
+      other.n_rows = 0;
+      other.capacity = n_inline;
+    }
+
+  public:
+    BasicSmallColumn()
+      : n_rows(0)
+      , capacity(n_inline)
+      , heap(nullptr)
+    {}
+
+    BasicSmallColumn(const size_t n_rows_in, const IndexType value)
+      : n_rows(0)
+      , capacity(n_inline)
+      , heap(nullptr)
+    {
+      resize(n_rows_in);
+      std::fill(begin(), end(), value);
+    }
+
+    BasicSmallColumn(const BasicSmallColumn& other)
+      : n_rows(0)
+      , capacity(n_inline)
+      , heap(nullptr)
+    {
+      assign(other.begin(), other.end());
+    }
+
+    BasicSmallColumn(BasicSmallColumn&& other) noexcept {
+      take(other);
+    }
+
+    ~BasicSmallColumn() {
+      release();
+    }
+
+    BasicSmallColumn& operator=(const BasicSmallColumn& other) {
+      if(this != &other)
+        assign(other.begin(), other.end());
+      return *this;
+    }
+
+    BasicSmallColumn& operator=(BasicSmallColumn&& other) noexcept {
+      if(this != &other) {
+        release();
+        take(other);
+      }
+      return *this;
+    }
+
+    size_t size() const {
+      return n_rows;
+    }
+
+    bool empty() const {
+      return n_rows == 0;
+    }
+
+    IndexType* data() {
+      return is_inline() ? local : heap;
+    }
+
+    const IndexType* data() const {
+      return is_inline() ? local : heap;
+    }
+
+    iterator begin() {
+      return data();
+    }
+
+    iterator end() {
+      return data() + n_rows;
+    }
+
+    const_iterator begin() const {
+      return data();
+    }
+
+    const_iterator end() const {
+      return data() + n_rows;
+    }
+
+    IndexType& operator[](const size_t idx) {
+      return data()[idx];
+    }
+
+    const IndexType& operator[](const size_t idx) const {
+      return data()[idx];
+    }
+
+    const IndexType& front() const {
+      return data()[0];
+    }
+
+    const IndexType& back() const {
+      return data()[n_rows - 1];
+    }
+
+    index_t get_max() const {
+      return n_rows ? back() : -1;
+    }
+
+    void reserve(const size_t new_capacity) {
+      if(new_capacity > capacity)
+        reallocate(new_capacity);
+    }
+
+    // New entries are zero, as with std::vector
+    void resize(const size_t new_n_rows) {
+      reserve(new_n_rows);
+      if(new_n_rows > n_rows)
+        std::fill(end(), begin() + new_n_rows, 0);
+      n_rows = new_n_rows;
+    }
+
+    void push_back(const IndexType value) {
+      if(n_rows == capacity)
+        reallocate(2 * capacity);
+      data()[n_rows++] = value;
+    }
+
+    void pop_back() {
+      --n_rows;
+    }
+
+    void clear() {
+      n_rows = 0;
+    }
+
+    template<typename Iterator>
+    void assign(Iterator first, Iterator last) {
+      const size_t new_n_rows = std::distance(first, last);
+      if(new_n_rows > capacity) {
+        n_rows = 0;
+        reallocate(new_n_rows);
+      }
+      std::copy(first, last, begin());
+      n_rows = new_n_rows;
+    }
+
+    iterator erase(iterator first, iterator last) {
+      std::copy(last, end(), first);
+      n_rows -= last - first;
+      return first;
+    }
+
+    void swap(BasicSmallColumn& other) {
+      BasicSmallColumn temp(std::move(other));
+      other = std::move(*this);
+      *this = std::move(temp);
+    }
+
+    bool operator==(const BasicSmallColumn& other) const {
+      return n_rows == other.n_rows && std::equal(begin(), end(), other.begin());
+    }
+
+    bool operator!=(const BasicSmallColumn& other) const {
+      return !(*this == other);
+    }
+
+    BasicSmallColumn& operator+=(const BasicSmallColumn& right) {
+      BasicSmallColumn temp;
+      column_sum(*this, right, temp);
+      swap(temp);
+      return *this;
+    }
+
+    BasicSmallColumn& operator-=(const BasicSmallColumn& right) {
+      BasicSmallColumn temp;
+      column_difference(*this, right, temp);
+      swap(temp);
+      return *this;
+    }
+
+    BasicSmallColumn& operator|=(const BasicSmallColumn& right) {
+      BasicSmallColumn temp;
+      column_union(*this, right, temp);
+      swap(temp);
+      return *this;
+    }
+
+  };
+
+  template<typename IndexType, size_t n_inline>
+  std::ostream& operator<<(std::ostream& os,
+                           const BasicSmallColumn<IndexType, n_inline>& col) {
+    os << "[";
+    for (size_t i = 0; i < col.size(); ++i) {
+      os << col[i];
+      if (i != col.size() - 1)
+        os << ", ";
+    }
+    os << "]\n";
+    return os;
+  }
+
+  template<typename IndexType, size_t n_inline>
+  BasicSmallColumn<IndexType, n_inline>
+  operator+(const BasicSmallColumn<IndexType, n_inline>& right,
+            const BasicSmallColumn<IndexType, n_inline>& left) {
+    BasicSmallColumn<IndexType, n_inline> res = left;
+    res += right;
+    return res;
+  }
+
+  template<typename IndexType, size_t n_inline>
+  BasicSmallColumn<IndexType, n_inline>
+  operator-(const BasicSmallColumn<IndexType, n_inline>& right,
+            const BasicSmallColumn<IndexType, n_inline>& left) {
+    BasicSmallColumn<IndexType, n_inline> res = left;
+    res -= right;
+    return res;
+  }
+
+  template<typename IndexType, size_t n_inline>
+  BasicSmallColumn<IndexType, n_inline>
+  operator|(const BasicSmallColumn<IndexType, n_inline>& right,
+            const BasicSmallColumn<IndexType, n_inline>& left) {
+    BasicSmallColumn<IndexType, n_inline> res = left;
+    res |= right;
+    return res;
+  }
+
+  // Room for the boundary of a tetrahedron
+  typedef BasicSmallColumn<index_t, 4> SmallColumn;
+  typedef BasicSmallColumn<int32_t, 4> SmallColumn32;
+
+} // namespace stn
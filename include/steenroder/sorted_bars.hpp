@@ -7,6 +7,8 @@
 #include "commons.hpp"
 #include "sorted_matrix.hpp"
 #include "vector_column.hpp"
+#include "frozen_columns.hpp"
+#include "ascii_writer.hpp"
 
 namespace stn {
 
@@ -18,15 +20,30 @@ namespace stn {
 
   protected:
     const index_t n_cells;
-    std::vector<index_t> births;
+    std::vector<typename Base::column_index_t> births;
     using Base::n_columns_per_dimension;
     using Base::start_dimension;
 
+    // Columns once frozen, which then no longer live in the matrix
+    bool is_frozen;
+    FrozenColumns<typename Base::column_index_t> frozen_columns;
+
   public:
     ViewInfiniteBars(const ViewMatrix<ColumnType>& boundaryMatrix_in)
       : Base(boundaryMatrix_in)
       , n_cells(boundaryMatrix_in.get_n_columns())
       , births(boundaryMatrix_in.get_n_columns(), -1)
+      , is_frozen(false)
+      , frozen_columns()
+    {}
+
+    // Takes over the columns of boundaryMatrix_in, which is left empty
+    ViewInfiniteBars(ViewMatrix<ColumnType>&& boundaryMatrix_in)
+      : Base(std::move(boundaryMatrix_in))
+      , n_cells(Base::get_n_columns())
+      , births(Base::get_n_columns(), -1)
+      , is_frozen(false)
+      , frozen_columns()
     {}
 
     ViewInfiniteBars(const index_t n_cells_in,
@@ -34,15 +51,53 @@ namespace stn {
       : Base(n_cells_in, n_dimensions_in)
       , n_cells(n_cells_in)
       , births(n_cells_in, -1)
+      , is_frozen(false)
+      , frozen_columns()
     {
-      for(index_t idx_col = 0; idx_col < n_cells_in; ++idx_col) {
-        VectorColumn col(1, idx_col);
-        Base::set_column(idx_col, col);
-      }
+      Base::set_identity(n_cells_in);
     }
 
     using Base::set_n_columns;
-    using Base::get_n_columns;
+
+    index_t get_n_columns() const {
+      return is_frozen ? frozen_columns.get_n_columns() : Base::get_n_columns();
+    }
+
+    // Packs the columns into a compressed read only encoding and releases
+    // the matrix, for bars that are only read by the Steenrod squares and
+    // the computation of their deaths. Columns are then decoded on each
+    // get_span and can only be cleared.
+    void freeze() {
+      if(is_frozen)
+        return;
+
+      const index_t n_columns = Base::get_n_columns();
+      for(index_t idx = 0; idx < n_columns; ++idx)
+        frozen_columns.append(Base::get_span(idx));
+      frozen_columns.shrink_to_fit();
+      std::vector<ColumnType> no_columns;
+      Base::load_columns(no_columns);
+      is_frozen = true;
+    }
+
+    ColumnSpan<typename Base::column_index_t> get_span(const index_t idx) const {
+      return is_frozen ? frozen_columns.get_span(idx) : Base::get_span(idx);
+    }
+
+    bool is_empty(const index_t idx) const {
+      return is_frozen ? frozen_columns.is_empty(idx) : Base::is_empty(idx);
+    }
+
+    index_t get_max_index(const index_t idx) const {
+      return is_frozen ? frozen_columns.get_max_index(idx) : Base::get_max_index(idx);
+    }
+
+    void clear(const index_t idx) {
+      if(is_frozen)
+        frozen_columns.clear(idx);
+      else
+        Base::clear(idx);
+    }
 
     index_t get_n_bars() const {
       return std::accumulate(Base::n_columns_per_dimension.begin(),
@@ -82,7 +137,7 @@ namespace stn {
     using Base = ViewInfiniteBars<ColumnType>;
 
   protected:
-    std::vector<index_t> deaths;
+    std::vector<typename Base::column_index_t> deaths;
 
   public:
     ViewFiniteBars(const ViewMatrix<ColumnType>& boundaryMatrix_in)
@@ -90,8 +145,18 @@ namespace stn {
       , deaths(boundaryMatrix_in.get_n_columns(), -1)
     {};
 
+    // The reduction then runs in place on the columns of boundaryMatrix_in
+    ViewFiniteBars(ViewMatrix<ColumnType>&& boundaryMatrix_in)
+      : Base(std::move(boundaryMatrix_in))
+      , deaths(Base::get_n_columns(), -1)
+    {};
+
     using Base::set_n_columns;
     using Base::get_n_columns;
+    using Base::get_span;
+    using Base::is_empty;
+    using Base::get_max_index;
+    using Base::clear;
     using Base::set_birth;
     using Base::get_birth;
 
@@ -124,86 +189,128 @@ namespace stn {
 
   // Saves the persistence pairs to given file in binary format
   // Format: nr_pairs % newline % dim1 %birth1 % death1 % newline % dim2 % birth2 % death2 % newline ...
+  // Only the dimensions in [min_dim, max_dim] are saved.
   template<typename ColumnType>
   bool save_pairs_ascii(const std::string& filename,
                         const ViewFiniteBars<ColumnType>& finite_bars,
-                        const ViewInfiniteBars<ColumnType>& infinite_bars) {
-    std::ofstream output_stream(filename.c_str());
-    if(output_stream.fail())
+                        const ViewInfiniteBars<ColumnType>& infinite_bars,
+                        const dimension_t min_dim, const dimension_t max_dim) {
+    AsciiWriter writer;
+    if(!writer.open(filename))
       return false;
 
     dimension_t n_dimensions = finite_bars.get_n_dimensions();
-    std::vector<index_t> n_finite_bars_per_dimension =
-      finite_bars.get_n_columns_per_dimension();
 
-    for(dimension_t dim = 0; dim < n_dimensions; ++dim) {
-      output_stream << "# dim " << (index_t) dim << std::endl;
+    for(dimension_t dim = std::max<dimension_t>(min_dim, 0);
+        dim < n_dimensions && dim <= max_dim; ++dim) {
+      writer.put("# dim ");
+      writer.put_index(dim);
+      writer.put('\n');
 
       index_t start_finite = finite_bars.get_start_dimension(dim);
       index_t end_finite = start_finite + finite_bars.get_n_columns_per_dimension(dim);
       index_t start_infinite = infinite_bars.get_start_dimension(dim);
       index_t end_infinite = start_infinite + infinite_bars.get_n_columns_per_dimension(dim);
 
-      output_stream << end_finite - start_finite + end_infinite - start_infinite
-                    << std::endl;
-
-      for(index_t idx_view = start_finite; idx_view < end_finite; ++idx_view) {
-        index_t idx_col = finite_bars.get_view(idx_view);
-
-        output_stream << finite_bars.get_birth(idx_col) << " "
-                      << finite_bars.get_death(idx_col) << std::endl;
-      }
-
-      for(index_t idx_view = start_infinite; idx_view < end_infinite; ++idx_view) {
-        index_t idx_col = infinite_bars.get_view(idx_view);
-
-        output_stream << infinite_bars.get_birth(idx_col) << " "
-                      << -1 << std::endl;
-      }
+      writer.put_index(end_finite - start_finite + end_infinite - start_infinite);
+      writer.put('\n');
+
+      writer.write_range(start_finite, end_finite,
+        [&](AsciiBuffer& buffer, index_t begin, index_t end) {
+          for(index_t idx_view = begin; idx_view < end; ++idx_view) {
+            index_t idx_col = finite_bars.get_view(idx_view);
+            buffer.put_index(finite_bars.get_birth(idx_col));
+            buffer.put(' ');
+            buffer.put_index(finite_bars.get_death(idx_col));
+            buffer.put('\n');
+          }
+        });
+
+      writer.write_range(start_infinite, end_infinite,
+        [&](AsciiBuffer& buffer, index_t begin, index_t end) {
+          for(index_t idx_view = begin; idx_view < end; ++idx_view) {
+            index_t idx_col = infinite_bars.get_view(idx_view);
+            buffer.put_index(infinite_bars.get_birth(idx_col));
+            buffer.put(" -1\n");
+          }
+        });
     }
 
-    output_stream.close();
-    return true;
+    return writer.close();
+  }
+
+  template<typename ColumnType>
+  bool save_pairs_ascii(const std::string& filename,
+                        const ViewFiniteBars<ColumnType>& finite_bars,
+                        const ViewInfiniteBars<ColumnType>& infinite_bars) {
+    return save_pairs_ascii(filename, finite_bars, infinite_bars,
+                            std::numeric_limits<dimension_t>::min(),
+                            std::numeric_limits<dimension_t>::max());
   }
 
   // Saves the persistence pairs to given file in binary format
-  // Format: nr_pairs % birth1 % death1 % birth2 % death2 ...
+  // Format: nr_pairs % dim1 % birth1 % death1 % dim2 % birth2 % death2 ...
+  // Only the pairs of dimension in [min_dim, max_dim] are saved, finite
+  // ones first.
   template<typename ColumnType>
   bool save_pairs_binary(const std::string& filename,
                          const ViewFiniteBars<ColumnType>& finite_bars,
-                         const ViewInfiniteBars<ColumnType>& infinite_bars) {
+                         const ViewInfiniteBars<ColumnType>& infinite_bars,
+                         const dimension_t min_dim, const dimension_t max_dim) {
     std::ofstream output_stream(filename.c_str(), std::ios_base::binary
                                 | std::ios_base::out );
     if( output_stream.fail() )
     return false;
 
-    index_t n_finite_pairs = finite_bars.get_n_columns();
-    index_t n_infinite_pairs = infinite_bars.get_n_columns();
-    index_t n_pairs = n_finite_pairs + n_infinite_pairs;
+    const dimension_t begin_dim = std::max<dimension_t>(min_dim, 0);
+    const dimension_t end_dim = (dimension_t) std::min<int64_t>((int64_t) max_dim + 1,
+                                                                finite_bars.get_n_dimensions());
+
+    index_t n_pairs = 0;
+    for(dimension_t dim = begin_dim; dim < end_dim; ++dim)
+      n_pairs += finite_bars.get_n_columns_per_dimension(dim)
+        + infinite_bars.get_n_columns_per_dimension(dim);
     output_stream.write((char*) &n_pairs, sizeof(index_t));
 
-    for(index_t index = 0; index < n_finite_pairs; ++index) {
-      dimension_t dim = finite_bars.get_dimension(index);
-      output_stream.write((char*) &dim, sizeof(dimension_t));
-      index_t birth = finite_bars.get_birth(index);
-      output_stream.write((char*) &birth, sizeof(index_t));
-      index_t death = finite_bars.get_death(index);
-      output_stream.write((char*) &death, sizeof(index_t));
+    for(dimension_t dim = begin_dim; dim < end_dim; ++dim) {
+      index_t start = finite_bars.get_start_dimension(dim);
+      index_t end = start + finite_bars.get_n_columns_per_dimension(dim);
+      for(index_t idx_view = start; idx_view < end; ++idx_view) {
+        index_t idx_col = finite_bars.get_view(idx_view);
+        output_stream.write((char*) &dim, sizeof(dimension_t));
+        index_t birth = finite_bars.get_birth(idx_col);
+        output_stream.write((char*) &birth, sizeof(index_t));
+        index_t death = finite_bars.get_death(idx_col);
+        output_stream.write((char*) &death, sizeof(index_t));
+      }
     }
 
-    for(index_t index = 0; index < n_infinite_pairs; ++index) {
-      dimension_t dim = infinite_bars.get_dimension(index);
-      output_stream.write((char*) &dim, sizeof(dimension_t));
-      index_t birth = infinite_bars.get_birth(index);
-      output_stream.write((char*) &birth, sizeof(index_t));
-      index_t death = -1;
-      output_stream.write((char*) &death, sizeof(int64_t));
+    for(dimension_t dim = begin_dim; dim < end_dim; ++dim) {
+      index_t start = infinite_bars.get_start_dimension(dim);
+      index_t end = start + infinite_bars.get_n_columns_per_dimension(dim);
+      for(index_t idx_view = start; idx_view < end; ++idx_view) {
+        index_t idx_col = infinite_bars.get_view(idx_view);
+        output_stream.write((char*) &dim, sizeof(dimension_t));
+        index_t birth = infinite_bars.get_birth(idx_col);
+        output_stream.write((char*) &birth, sizeof(index_t));
+        index_t death = -1;
+        output_stream.write((char*) &death, sizeof(int64_t));
+      }
     }
 
     output_stream.close();
     return true;
   }
 
+  template<typename ColumnType>
+  bool save_pairs_binary(const std::string& filename,
+                         const ViewFiniteBars<ColumnType>& finite_bars,
+                         const ViewInfiniteBars<ColumnType>& infinite_bars) {
+    return save_pairs_binary(filename, finite_bars, infinite_bars,
+                             std::numeric_limits<dimension_t>::min(),
+                             std::numeric_limits<dimension_t>::max());
+  }
+
 
   template<typename ColumnType = VectorColumn>
   class Bars : public ViewMatrix<ColumnType> {
@@ -212,8 +319,8 @@ namespace stn {
 
   protected:
     const index_t n_cells;
-    std::vector<index_t> births;
-    std::vector<index_t> deaths;
+    std::vector<typename Base::column_index_t> births;
+    std::vector<typename Base::column_index_t> deaths;
     using Base::n_columns_per_dimension;
     using Base::start_dimension;
 
@@ -225,17 +332,13 @@ namespace stn {
       , deaths(boundaryMatrix_in.get_n_columns(), -1)
     {}
 
+    // Columns start empty and are set as the Steenrod squares are computed
     Bars(const index_t n_cells_in)
       : Base(n_cells_in, 1)
       , n_cells(n_cells_in)
       , births(n_cells_in, -1)
       , deaths(n_cells_in, -1)
-    {
-      for(index_t idx_col = 0; idx_col < n_cells_in; ++idx_col) {
-        VectorColumn col(1, idx_col);
-        Base::set_column(idx_col, col);
-      }
-    }
+    {}
 
     using Base::set_n_columns;
     using Base::get_n_columns;
@@ -289,29 +392,35 @@ namespace stn {
   template<typename ColumnType>
   bool save_pairs_ascii(const std::string& filename,
                         const Bars<ColumnType>& bars) {
-    std::ofstream output_stream(filename.c_str());
-    if(output_stream.fail())
+    AsciiWriter writer;
+    if(!writer.open(filename))
       return false;
 
     dimension_t n_dimensions = bars.get_n_dimensions();
 
     for(dimension_t dim = 0; dim < n_dimensions; ++dim) {
-      output_stream << "# dim " << (index_t) dim << std::endl;
+      writer.put("# dim ");
+      writer.put_index(dim);
+      writer.put('\n');
       index_t start = bars.get_start_dimension(dim);
       index_t end = start + bars.get_n_columns_per_dimension(dim);
 
-      output_stream << end - start << std::endl;
-
-      for(index_t idx_view = start; idx_view < end; ++idx_view) {
-        index_t idx_col = bars.get_view(idx_view);
-
-        output_stream << bars.get_birth(idx_col) << " "
-                      << bars.get_death(idx_col) << std::endl;
-      }
+      writer.put_index(end - start);
+      writer.put('\n');
+
+      writer.write_range(start, end,
+        [&](AsciiBuffer& buffer, index_t begin_view, index_t end_view) {
+          for(index_t idx_view = begin_view; idx_view < end_view; ++idx_view) {
+            index_t idx_col = bars.get_view(idx_view);
+            buffer.put_index(bars.get_birth(idx_col));
+            buffer.put(' ');
+            buffer.put_index(bars.get_death(idx_col));
+            buffer.put('\n');
+          }
+        });
     }
 
-    output_stream.close();
-    return true;
+    return writer.close();
   }
 
 } // namespace stn
@@ -10,6 +10,9 @@
 #include "commons.hpp"
 #include "sparse_matrix.hpp"
 #include "vector_column.hpp"
+#include "ascii_reader.hpp"
+#include "binary_format.hpp"
+#include "ascii_writer.hpp"
 
 namespace stn {
 
@@ -18,12 +21,76 @@ namespace stn {
   private:
     using Base = SparseMatrix<ColumnType>;
 
+  public:
+    using column_index_t = typename Base::column_index_t;
+
   protected:
-    std::vector<index_t> view;
+    std::vector<column_index_t> view;
     dimension_t n_dimensions;
     std::vector<index_t> n_columns_per_dimension;
     std::vector<index_t> start_dimension;
 
+    // Builds the anti-transpose of the given primal columns. row_counts holds
+    // the number of entries in each primal row, so that each dual column is
+    // allocated once and filled in sorted order. Only dual columns of
+    // dimension in [min_dim, max_dim] are filled, from the primal columns one
+    // dimension above. Primal columns are released as soon as they are
+    // scattered when release_primal is set. Fails when a row is not the index
+    // of a column.
+    bool load_anti_transpose(std::vector<ColumnType>& primal_columns,
+                             const std::vector<dimension_t>& primal_dimensions,
+                             const std::vector<index_t>& row_counts,
+                             const dimension_t min_dim, const dimension_t max_dim,
+                             const bool release_primal) {
+      const index_t n_columns = (index_t) primal_columns.size();
+      if((index_t) row_counts.size() > n_columns)
+        return false;
+
+      std::vector<ColumnType> dual_columns(n_columns);
+      for(index_t idx_row = 0; idx_row < (index_t) row_counts.size(); ++idx_row) {
+        if(primal_dimensions[idx_row] >= min_dim && primal_dimensions[idx_row] <= max_dim)
+          dual_columns[n_columns - 1 - idx_row].reserve(row_counts[idx_row]);
+      }
+
+      std::vector<dimension_t> dimensions(n_columns, -1);
+      for(index_t idx_col = n_columns - 1; idx_col >= 0; --idx_col) {
+        dimensions[n_columns - 1 - idx_col] = primal_dimensions[idx_col];
+        const int64_t dual_dim = (int64_t) primal_dimensions[idx_col] - 1;
+        if(dual_dim >= min_dim && dual_dim <= max_dim) {
+          for(index_t idx_row : primal_columns[idx_col])
+            dual_columns[n_columns - 1 - idx_row].push_back(n_columns - 1 - idx_col);
+        }
+        if(release_primal)
+          ColumnType().swap(primal_columns[idx_col]);
+      }
+
+      Base::load_columns(dual_columns);
+      view.resize(n_columns);
+      create_view(dimensions);
+      return true;
+    }
+
+    // Same, counting the entries of each row first
+    bool load_anti_transpose(std::vector<ColumnType>& primal_columns,
+                             const std::vector<dimension_t>& primal_dimensions,
+                             const dimension_t min_dim, const dimension_t max_dim,
+                             const bool release_primal) {
+      const index_t n_columns = (index_t) primal_columns.size();
+      std::vector<index_t> row_counts(n_columns, 0);
+      for(index_t idx_col = 0; idx_col < n_columns; ++idx_col) {
+        const int64_t dual_dim = (int64_t) primal_dimensions[idx_col] - 1;
+        if(dual_dim < min_dim || dual_dim > max_dim)
+          continue;
+        const ColumnType& col = primal_columns[idx_col];
+        if(!col.empty() && (col.front() < 0 || col.back() >= n_columns))
+          return false;
+        for(index_t idx_row : col)
+          ++row_counts[idx_row];
+      }
+      return load_anti_transpose(primal_columns, primal_dimensions, row_counts,
+                                 min_dim, max_dim, release_primal);
+    }
+
   public:
     ViewMatrix()
       : Base()
@@ -57,6 +124,20 @@ namespace stn {
       }
     }
 
+    // Takes over the columns and view of view_matrix_in, which is left empty
+    ViewMatrix(ViewMatrix<ColumnType>&& view_matrix_in)
+      : Base(std::move(view_matrix_in))
+      , view(std::move(view_matrix_in.view))
+      , n_dimensions(view_matrix_in.n_dimensions)
+      , n_columns_per_dimension(std::move(view_matrix_in.n_columns_per_dimension))
+      , start_dimension(std::move(view_matrix_in.start_dimension))
+    {
+      view_matrix_in.n_dimensions = 0;
+    }
+
+    ViewMatrix<ColumnType>& operator=(const ViewMatrix<ColumnType>& other) = default;
+    ViewMatrix<ColumnType>& operator=(ViewMatrix<ColumnType>&& other) = default;
+
     ViewMatrix(const index_t n_columns_in,
                const dimension_t n_dimensions_in)
       : Base(n_columns_in)
@@ -143,7 +224,7 @@ namespace stn {
       return view[idx_view];
     }
 
-    std::vector<index_t>& get_view() {
+    std::vector<column_index_t>& get_view() {
       return view;
     }
 
@@ -151,7 +232,7 @@ namespace stn {
       view[idx_view] = idx_col;
     }
 
-    void set_view(std::vector<index_t>& view_in) {
+    void set_view(std::vector<column_index_t>& view_in) {
       view.swap(view_in);
     }
 
@@ -197,202 +278,281 @@ namespace stn {
     //   return *this;
     // }
 
-    bool load_ascii(std::string filename) {
-      // first count number of columns:
-      std::string line;
-      std::ifstream dummy(filename .c_str());
-      if(dummy.fail())
+    bool load_ascii(std::string filename, ParseStatistics& stats) {
+      AsciiReader reader;
+      if(!reader.open(filename))
         return false;
 
-      index_t n_columns = 0;
-      while(getline(dummy, line)) {
-        line.erase(line.find_last_not_of(" \t\n\r\f\v") + 1);
-        if(line != "" && line[0] != '#')
-          n_columns++;
+      std::vector<ColumnType> columns;
+      std::vector<dimension_t> dimensions;
+      if(!reader.read_columns(columns, dimensions))
+        return false;
 
-      }
-      set_n_columns(n_columns);
-      dummy.close();
+      Base::load_columns(columns);
+      view.resize(Base::get_n_columns());
+      create_view(dimensions);
 
-      std::vector<dimension_t> dimensions(n_columns, -1);
+      reader.get_statistics(stats);
+      return true;
+    }
 
-      std::ifstream input_stream(filename.c_str());
-      if(input_stream.fail())
+    bool load_ascii(std::string filename) {
+      ParseStatistics stats;
+      return load_ascii(filename, stats);
+    }
+
+    // Loads this matrix and its anti-transpose dual_matrix from a single
+    // parse. Only the columns of dual_matrix of dimension in
+    // [min_dual_dim, max_dual_dim] are filled, all others are left empty.
+    bool load_ascii(std::string filename, ViewMatrix<ColumnType>& dual_matrix,
+                    const dimension_t min_dual_dim, const dimension_t max_dual_dim,
+                    ParseStatistics& stats) {
+      AsciiReader reader;
+      if(!reader.open(filename))
         return false;
 
-      VectorColumn temp_col;
-      index_t idx = -1;
-      while(getline(input_stream, line)) {
-        line.erase(line.find_last_not_of(" \t\n\r\f\v") + 1);
-        if(line != "" && line[0] != '#') {
-          idx++;
-          std::stringstream ss(line);
-
-          index_t att;
-          ss >> att;
-          dimensions[idx] = (index_t) att;
-
-          index_t temp_index;
-          temp_col.clear();
-          while(ss.good()) {
-            ss >> temp_index;
-            temp_col.push_back((index_t)temp_index);
-          }
-          std::sort(temp_col.begin(), temp_col.end());
-          Base::set_column(idx, temp_col);
-        }
-      }
+      std::vector<ColumnType> columns;
+      std::vector<dimension_t> dimensions;
+      std::vector<index_t> row_counts;
+      if(!reader.read_columns(columns, dimensions, row_counts)
+         || !dual_matrix.load_anti_transpose(columns, dimensions, row_counts,
+                                             min_dual_dim, max_dual_dim, false))
+        return false;
+
+      Base::load_columns(columns);
+      view.resize(Base::get_n_columns());
       create_view(dimensions);
 
-      input_stream.close();
+      reader.get_statistics(stats);
       return true;
     }
 
-    bool load_ascii_dual(std::string filename) {
-      // first count number of columns:
-      std::string line;
-      std::ifstream dummy(filename .c_str());
-      if(dummy.fail())
+    bool load_ascii(std::string filename, ViewMatrix<ColumnType>& dual_matrix,
+                    ParseStatistics& stats) {
+      return load_ascii(filename, dual_matrix, std::numeric_limits<dimension_t>::min(),
+                        std::numeric_limits<dimension_t>::max(), stats);
+    }
+
+    bool load_ascii(std::string filename, ViewMatrix<ColumnType>& dual_matrix) {
+      ParseStatistics stats;
+      return load_ascii(filename, dual_matrix, stats);
+    }
+
+    bool load_ascii_dual(std::string filename, ParseStatistics& stats) {
+      AsciiReader reader;
+      if(!reader.open(filename))
         return false;
 
-      index_t n_columns = 0;
-      while(getline(dummy, line)) {
-        line.erase(line.find_last_not_of(" \t\n\r\f\v") + 1);
-        if(line != "" && line[0] != '#')
-          ++n_columns;
+      std::vector<ColumnType> primal_columns;
+      std::vector<dimension_t> primal_dimensions;
+      std::vector<index_t> row_counts;
+      if(!reader.read_columns(primal_columns, primal_dimensions, row_counts)
+         || !load_anti_transpose(primal_columns, primal_dimensions, row_counts,
+                                 std::numeric_limits<dimension_t>::min(),
+                                 std::numeric_limits<dimension_t>::max(), true))
+        return false;
 
-      }
-      set_n_columns(n_columns);
-      dummy.close();
+      reader.get_statistics(stats);
+      return true;
+    }
 
-      std::vector<dimension_t> dimensions(n_columns, -1);
+    bool load_ascii_dual(std::string filename) {
+      ParseStatistics stats;
+      return load_ascii_dual(filename, stats);
+    }
 
-      std::ifstream input_stream(filename.c_str());
-      if(input_stream.fail())
+    // Accepts every binary layout described in binary_format.hpp.
+    // Streams the file twice: the first pass counts the entries of each row,
+    // the second one scatters them into exactly sized dual columns.
+    // Only dual columns of dimension in [min_dim, max_dim] are filled, which
+    // only requires reading the primal columns one dimension above.
+    bool load_binary_dual(std::string filename, const dimension_t min_dim,
+                          const dimension_t max_dim) {
+      MappedFile file;
+      if(!file.open(filename))
         return false;
 
-      VectorColumn temp_col;
-      index_t idx_col = -1;
-      while(getline(input_stream, line)) {
-        line.erase(line.find_last_not_of(" \t\n\r\f\v") + 1);
-        if(line != "" && line[0] != '#') {
-          ++idx_col;
-          std::stringstream ss(line);
-
-          index_t dim;
-          ss >> dim;
-          dimensions[n_columns - 1 - idx_col] = dim;
-
-          index_t idx_row;
-          temp_col.clear();
-          while(ss.good()) {
-            ss >> idx_row;
-            Base::matrix[n_columns - 1 - idx_row].push_back(n_columns - 1 - idx_col);
+      std::vector<dimension_t> primal_dimensions;
+      if(!read_binary_attributes(file, primal_dimensions))
+        return false;
+      const index_t n_columns = primal_dimensions.size();
+      const int64_t min_primal_dim = (int64_t) min_dim + 1;
+      const int64_t max_primal_dim = (int64_t) max_dim + 1;
+
+      bool valid = true;
+      std::vector<index_t> row_counts(n_columns, 0);
+      valid = valid && scan_binary(file, min_primal_dim, max_primal_dim,
+        [&](index_t /* idx_col */, int64_t /* dim */, const int64_t* rows, int64_t n_rows) {
+          for(int64_t idx = 0; idx < n_rows; ++idx) {
+            if(rows[idx] < 0 || rows[idx] >= n_columns) {
+              valid = false;
+              return;
+            }
+            ++row_counts[rows[idx]];
           }
-        }
-      }
+        });
+      if(!valid)
+        return false;
 
-      dimension_t max_dimension = *std::max_element(dimensions.begin(),
-                                                    dimensions.end());
+      std::vector<ColumnType> dual_columns(n_columns);
+      for(index_t idx_row = 0; idx_row < n_columns; ++idx_row)
+        dual_columns[n_columns - 1 - idx_row].resize(row_counts[idx_row]);
 
-      for(index_t idx_col = 0; idx_col < n_columns; idx_col++) {
-        std::sort(Base::matrix[idx_col].begin(), Base::matrix[idx_col].end());
-      }
+      // Dual columns are filled back to front so that they end up sorted
+      std::vector<dimension_t> dimensions(n_columns, -1);
+      for(index_t idx_col = 0; idx_col < n_columns; ++idx_col)
+        dimensions[n_columns - 1 - idx_col] = primal_dimensions[idx_col];
+      std::vector<dimension_t>().swap(primal_dimensions);
+
+      // The file may have changed since the first pass, so entries beyond
+      // the counted ones are rejected and every count must be used up
+      valid = valid && scan_binary(file, min_primal_dim, max_primal_dim,
+        [&](index_t idx_col, int64_t /* dim */, const int64_t* rows, int64_t n_rows) {
+          for(int64_t idx = 0; idx < n_rows; ++idx) {
+            if(rows[idx] < 0 || rows[idx] >= n_columns || row_counts[rows[idx]] == 0) {
+              valid = false;
+              return;
+            }
+            ColumnType& dual_col = dual_columns[n_columns - 1 - rows[idx]];
+            dual_col[--row_counts[rows[idx]]] = n_columns - 1 - idx_col;
+          }
+        });
+      for(index_t idx_row = 0; valid && idx_row < n_columns; ++idx_row)
+        valid = row_counts[idx_row] == 0;
+      if(!valid)
+        return false;
 
+      Base::load_columns(dual_columns);
+      view.resize(n_columns);
       create_view(dimensions);
-
-      input_stream.close();
       return true;
     }
 
     bool load_binary_dual(std::string filename) {
-      return true;
+      return load_binary_dual(filename, std::numeric_limits<dimension_t>::min(),
+                              std::numeric_limits<dimension_t>::max());
     }
 
     // Format: each line represents a column, first number is attribute, other numbers are the content of the column
-    bool save_ascii(const std::string& name, const std::string& output_filename) {
+    bool save_ascii(const std::string& name, const std::string& output_filename) const {
       std::string filename = output_filename + "_" + name + ".dat";
-      std::ofstream output_stream(filename.c_str());
-      if(output_stream.fail())
+      AsciiWriter writer;
+      if(!writer.open(filename))
         return false;
 
-      VectorColumn temp_col;
       for(dimension_t dim = 0; dim < n_dimensions; ++dim) {
-        output_stream << "# dim " << (index_t) dim << std::endl;
+        writer.put("# dim ");
+        writer.put_index(dim);
+        writer.put('\n');
 
         index_t start = start_dimension[dim];
         index_t end = start + n_columns_per_dimension[dim];
-        for(index_t view_idx = start; view_idx < end; ++view_idx) {
-          output_stream << view[view_idx] << " ";
-          Base::get_column(view[view_idx], temp_col);
-          output_stream << temp_col;
-        }
+        writer.write_range(start, end,
+          [&](AsciiBuffer& buffer, index_t begin_view, index_t end_view) {
+            for(index_t view_idx = begin_view; view_idx < end_view; ++view_idx) {
+              buffer.put_index(view[view_idx]);
+              buffer.put(' ');
+              buffer.put_list(Base::column_begin(view[view_idx]),
+                              Base::column_end(view[view_idx]));
+              buffer.put('\n');
+            }
+          });
       }
 
-      output_stream.close();
-      return true;
+      return writer.close();
     }
 
-    // Format: n_columns % att1 % N1 % row1 row2 % ...% rowN1 % att2 % N2 % ...
+    // Accepts every binary layout described in binary_format.hpp
     bool load_binary(std::string filename) {
-      std::ifstream input_stream(filename.c_str(), std::ios_base::binary | std::ios_base::in);
-      if(input_stream.fail())
+      std::vector<ColumnType> columns;
+      std::vector<dimension_t> dimensions;
+      if(!load_binary_columns(filename, columns, dimensions))
         return false;
 
-      index_t n_columns;
-      input_stream.read((char*) &n_columns, sizeof(int64_t));
-      set_n_columns((index_t) n_columns);
-
-      std::vector<dimension_t> dimensions(n_columns);
-
-      VectorColumn temp_col;
-      for(index_t idx = 0; idx < n_columns; idx++) {
-        index_t att;
-        input_stream.read((char*) &att, sizeof(int64_t));
-        dimensions[idx] = (index_t) att;
-        index_t n_rows;
-        input_stream.read((char*) &n_rows, sizeof(int64_t));
-        temp_col.resize((std::size_t) n_rows);
-        for(index_t idx = 0; idx < n_rows; ++idx) {
-          index_t row;
-          input_stream.read((char*)& row, sizeof(int64_t));
-          temp_col[idx] = (index_t) row;
-        }
-        Base::set_column(idx, temp_col);
-      }
+      Base::load_columns(columns);
+      view.resize(Base::get_n_columns());
+      create_view(dimensions);
+      return true;
+    }
 
+    // Only the columns of dimension in [min_dim, max_dim] are read, all
+    // others are left empty. The view still covers every column.
+    bool load_binary(std::string filename, const dimension_t min_dim,
+                     const dimension_t max_dim) {
+      std::vector<ColumnType> columns;
+      std::vector<dimension_t> dimensions;
+      if(!load_binary_columns(filename, columns, dimensions, min_dim, max_dim))
+        return false;
+
+      Base::load_columns(columns);
+      view.resize(Base::get_n_columns());
       create_view(dimensions);
+      return true;
+    }
+
+    // Loads this matrix and its anti-transpose dual_matrix from a single
+    // pass over the file. Only the columns of this matrix of dimension in
+    // [min_dim, max_dim] and those of dual_matrix of dimension in
+    // [min_dual_dim, max_dual_dim] are filled, so only the primal columns
+    // these need are read.
+    bool load_binary(std::string filename, ViewMatrix<ColumnType>& dual_matrix,
+                     const dimension_t min_dim, const dimension_t max_dim,
+                     const dimension_t min_dual_dim, const dimension_t max_dual_dim) {
+      const int64_t min_read_dim = std::min<int64_t>(min_dim, (int64_t) min_dual_dim + 1);
+      const int64_t max_read_dim = std::max<int64_t>(max_dim, (int64_t) max_dual_dim + 1);
+      std::vector<ColumnType> columns;
+      std::vector<dimension_t> dimensions;
+      if(!load_binary_columns(filename, columns, dimensions, min_read_dim, max_read_dim)
+         || !dual_matrix.load_anti_transpose(columns, dimensions, min_dual_dim,
+                                             max_dual_dim, false))
+        return false;
 
-      input_stream.close();
+      for(index_t idx_col = 0; idx_col < (index_t) columns.size(); ++idx_col) {
+        if(dimensions[idx_col] < min_dim || dimensions[idx_col] > max_dim)
+          ColumnType().swap(columns[idx_col]);
+      }
+      Base::load_columns(columns);
+      view.resize(Base::get_n_columns());
+      create_view(dimensions);
       return true;
     }
 
-    // Format: n_columns % att1 % N1 % row1 row2 % ...% rowN1 % att2 % N2 % ...
-    bool save_binary(const std::string& name, const std::string& output_filename) {
-      std::string filename = output_filename + "_" + name + ".dat";
+    bool load_binary(std::string filename, ViewMatrix<ColumnType>& dual_matrix,
+                     const dimension_t min_dim, const dimension_t max_dim) {
+      return load_binary(filename, dual_matrix, min_dim, max_dim,
+                         std::numeric_limits<dimension_t>::min(),
+                         std::numeric_limits<dimension_t>::max());
+    }
 
-      std::ofstream output_stream(filename.c_str(),
-                                  std::ios_base::binary | std::ios_base::out);
-      if(output_stream.fail())
-        return false;
+    bool load_binary(std::string filename, ViewMatrix<ColumnType>& dual_matrix) {
+      return load_binary(filename, dual_matrix, std::numeric_limits<dimension_t>::min(),
+                         std::numeric_limits<dimension_t>::max());
+    }
 
-      const index_t n_columns = Base::get_n_columns();
-      output_stream.write((char*) &n_columns, sizeof(int64_t));
-      VectorColumn temp_col;
-      for(index_t idx = 0; idx < n_columns; idx++) {
-        index_t att = get_dimension(idx);
-        output_stream.write((char*) &att, sizeof(int64_t));
-        Base::get_column(idx, temp_col);
-        index_t n_rows = temp_col.size();
-        output_stream.write((char*) &n_rows, sizeof(int64_t));
-        for(index_t row_idx = 0; row_idx < (index_t) temp_col.size(); row_idx++) {
-          index_t row = temp_col[row_idx];
-          output_stream.write((char*) &row, sizeof(int64_t));
-        }
+    // Dimension of each column, in column order
+    std::vector<dimension_t> get_dimensions() const {
+      std::vector<dimension_t> dimensions(Base::get_n_columns(), -1);
+      for(dimension_t dim = 0; dim < n_dimensions; ++dim) {
+        index_t start = start_dimension[dim];
+        index_t end = start + n_columns_per_dimension[dim];
+        for(index_t view_idx = start; view_idx < end; ++view_idx)
+          dimensions[view[view_idx]] = dim;
       }
+      return dimensions;
+    }
 
-      output_stream.close();
-      return true;
+    // Writes the CSR layout described in binary_format.hpp
+    bool save_binary(const std::string& filename) const {
+      return save_binary_columns(filename, *this, get_dimensions());
+    }
+
+    // Writes the compressed layout described in compressed_format.hpp
+    bool save_compressed(const std::string& filename) const {
+      return save_compressed_columns(filename, *this, get_dimensions());
+    }
+
+    bool save_binary(const std::string& name, const std::string& output_filename) const {
+      return save_binary(output_filename + "_" + name + ".dat");
     }
 
   };
@@ -0,0 +1,88 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include "commons.hpp"
+#include "abstract_pivot_column.hpp"
+#include "column_operations.hpp"
+
+namespace stn {
+
+  // Sorted column of type ColumnType, to which columns are added by merging
+  // into a second one that is then swapped in. This is how the matrices add
+  // columns, so it does best when the columns stay sparse.
+  template<typename ColumnType>
+  class SparsePivotColumn
+    : public AbstractPivotColumn<SparsePivotColumn<ColumnType>> {
+  private:
+    ColumnType col;
+    ColumnType temp_col;
+
+  public:
+    SparsePivotColumn()
+      : col()
+      , temp_col()
+    {}
+
+    void init(const index_t /* n_rows */) {
+      col.clear();
+    }
+
+    index_t get_max_index() const {
+      return col.empty() ? -1 : col.back();
+    }
+
+    bool is_empty() const {
+      return col.empty();
+    }
+
+    size_t size() const {
+      return col.size();
+    }
+
+    void add_index(const index_t row) {
+      typename ColumnType::iterator position = std::lower_bound(col.begin(), col.end(), row);
+      if(position != col.end() && *position == row)
+        col.erase(position, position + 1);
+      else
+        column_insert(col, row);
+    }
+
+    template<typename Column>
+    void add_col(const Column& other) {
+      column_sum(col, other, temp_col);
+      col.swap(temp_col);
+    }
+
+    index_t pop_max_index() {
+      const index_t max_index = get_max_index();
+      if(max_index != -1)
+        col.pop_back();
+      return max_index;
+    }
+
+    template<typename Column>
+    void get_col_and_clear(Column& out) {
+      out.assign(col.begin(), col.end());
+      col.clear();
+    }
+
+    void get_col_and_clear(ColumnType& out) {
+      out.swap(col);
+      col.clear();
+    }
+
+    void clear() {
+      col.clear();
+    }
+
+    template<typename Column>
+    void set_col(const Column& other) {
+      col.assign(other.begin(), other.end());
+    }
+
+  };
+
+} // namespace stn
@@ -4,17 +4,64 @@
 
 #pragma once
 
+#include <numeric>
+
 #include "commons.hpp"
+#include "column_operations.hpp"
+#include "column_span.hpp"
 #include "vector_column.hpp"
 
 namespace stn {
 
+  // Whether distinct columns of a SparseMatrix<ColumnType> can be written
+  // from several threads at once
+  template<typename ColumnType>
+  struct ConcurrentColumnWrites {
+    enum { value = true };
+  };
+
   template<typename ColumnType>
   class SparseMatrix {
+  public:
+    // Type in which row indices are stored, which the views, bars and
+    // reductions built on this matrix use as well
+    using column_index_t = typename ColumnType::value_type;
+
   protected:
     std::vector<ColumnType> matrix;
     thread_local_storage<ColumnType> temp_column_buffer;
 
+    // Row of each column that is still the unit vector set by set_identity,
+    // or -1 once it has been written. Such columns are only stored in matrix
+    // when first modified. Empty when set_identity was never called.
+    std::vector<column_index_t> identity;
+
+    bool is_identity(const index_t idx) const {
+      return !identity.empty() && identity[idx] != -1;
+    }
+
+    // Stores the unit vector of column idx before it is modified
+    ColumnType& materialize(const index_t idx) {
+      if(is_identity(idx)) {
+        matrix[idx].assign(&identity[idx], &identity[idx] + 1);
+        identity[idx] = -1;
+      }
+      return matrix[idx];
+    }
+
+    void forget_identity(const index_t idx) {
+      if(!identity.empty())
+        identity[idx] = -1;
+    }
+
+    // Exchanges the stored column idx with col, so that whole columns move
+    // between matrices without being copied
+    void swap_column(const index_t idx, ColumnType& col) {
+      materialize(idx).swap(col);
+    }
+
+    template<typename> friend class MatrixVector;
+
   public:
     SparseMatrix()
       : matrix()
@@ -24,92 +71,147 @@ namespace stn {
       : matrix(n_columns_in)
     {}
 
+    // The scratch buffers are not part of the matrix, so they are neither
+    // copied nor moved
+    SparseMatrix(const SparseMatrix& other)
+      : matrix(other.matrix)
+      , identity(other.identity)
+    {}
+
+    SparseMatrix(SparseMatrix&& other)
+      : matrix(std::move(other.matrix))
+      , identity(std::move(other.identity))
+    {}
+
+    SparseMatrix& operator=(const SparseMatrix& other) {
+      matrix = other.matrix;
+      identity = other.identity;
+      return *this;
+    }
+
+    SparseMatrix& operator=(SparseMatrix&& other) {
+      matrix = std::move(other.matrix);
+      identity = std::move(other.identity);
+      return *this;
+    }
+
     index_t get_n_columns() const {
       return (index_t) matrix.size();
     }
 
     void set_n_columns(const index_t n_columns) {
       matrix.resize(n_columns);
+      if(!identity.empty())
+        identity.resize(n_columns, -1);
     }
 
-    void get_column(const index_t idx, ColumnType& col) const {
-      col = matrix[idx];
+    // Makes this the n_columns identity matrix without storing any column
+    void set_identity(const index_t n_columns) {
+      matrix.clear();
+      matrix.resize(n_columns);
+      identity.resize(n_columns);
+      std::iota(identity.begin(), identity.end(), 0);
+    }
+
+    // Same with the unit vector of column idx at row rows[idx]
+    void set_identity(const std::vector<column_index_t>& rows) {
+      matrix.clear();
+      matrix.resize(rows.size());
+      identity = rows;
     }
-    void set_column(const index_t idx, const ColumnType& col) {
-      matrix[idx] = col;
+
+    template<typename Column>
+    void get_column(const index_t idx, Column& col) const {
+      col.assign(column_begin(idx), column_end(idx));
+    }
+
+    template<typename Column>
+    void set_column(const index_t idx, const Column& col) {
+      forget_identity(idx);
+      matrix[idx].assign(col.begin(), col.end());
+    }
+
+    // Takes over the given columns, which are left empty
+    void load_columns(std::vector<ColumnType>& columns) {
+      matrix.swap(columns);
+      std::vector<ColumnType>().swap(columns);
+      std::vector<column_index_t>().swap(identity);
+    }
+
+    // Entries of a column, valid until the matrix is next modified
+    const column_index_t* column_begin(const index_t idx) const {
+      return is_identity(idx) ? &identity[idx] : matrix[idx].data();
+    }
+
+    const column_index_t* column_end(const index_t idx) const {
+      return is_identity(idx) ? &identity[idx] + 1 : matrix[idx].data() + matrix[idx].size();
+    }
+
+    // Column read in place, for callers that do not modify it
+    ColumnSpan<column_index_t> get_span(const index_t idx) const {
+      return ColumnSpan<column_index_t>(column_begin(idx), column_end(idx));
     }
 
     bool is_empty(const index_t idx) const {
-      return matrix[idx].empty();
+      return matrix[idx].empty() && !is_identity(idx);
     }
 
     index_t get_max_index(const index_t idx) const {
+      if(is_identity(idx))
+        return identity[idx];
       return matrix[idx].empty() ? -1 : matrix[idx].back();
     }
 
     void remove_max(const index_t idx) {
-      matrix[idx].pop_back();
+      if(is_identity(idx))
+        identity[idx] = -1;
+      else
+        matrix[idx].pop_back();
     }
 
     void clear(const index_t idx) {
+      forget_identity(idx);
       matrix[idx].clear();
     }
 
     void swap(const index_t idx_1, const index_t idx_2) {
       std::swap(matrix[idx_1], matrix[idx_2]);
+      if(!identity.empty())
+        std::swap(identity[idx_1], identity[idx_2]);
     }
 
     void erase(const index_t idx) {
       matrix.erase(matrix.begin() + idx);
+      if(!identity.empty())
+        identity.erase(identity.begin() + idx);
     }
 
-    void append(const VectorColumn& col) {
+    template<typename Column>
+    void append(const Column& col) {
       index_t n_columns =  get_n_columns();
       set_n_columns(n_columns + 1);
       set_column(n_columns, col);
     }
 
     void add(const index_t source, const index_t target) {
-      ColumnType& source_col = matrix[source];
-      ColumnType& target_col = matrix[target];
-      ColumnType& temp_col = temp_column_buffer();
-
-      size_t new_size = source_col.size() + target_col.size();
-      if(new_size > temp_col.size()) {
-        temp_col.resize(new_size);
-      }
+      add(get_span(source), target);
+    }
 
-      std::vector<index_t>::iterator col_end =
-        std::set_symmetric_difference(target_col.begin(), target_col.end(),
-                                      source_col.begin(), source_col.end(),
-                                      temp_col.begin());
+    // The source may be a span of any column but the target
+    void add(const ColumnSpan<column_index_t>& source_col, const index_t target) {
+      ColumnType& target_col = materialize(target);
+      ColumnType& temp_col = temp_column_buffer();
 
-      temp_col.erase(col_end, temp_col.end());
+      column_sum(target_col, source_col, temp_col);
       target_col.swap(temp_col);
     }
 
     void add(const ColumnType& source_col, const index_t target) {
-      ColumnType& target_col = matrix[target];
-      ColumnType& temp_col = temp_column_buffer();
-
-      size_t new_size = source_col.size() + target_col.size();
-      if(new_size > temp_col.size()) {
-        temp_col.resize(new_size);
-      }
-
-      std::vector<index_t>::iterator col_end =
-        std::set_symmetric_difference(target_col.begin(), target_col.end(),
-                                      source_col.begin(), source_col.end(),
-                                      temp_col.begin());
-
-      temp_col.erase(col_end, temp_col.end());
-      target_col.swap(temp_col);
+      add(make_span(source_col), target);
     }
 
     index_t get_n_rows(const index_t idx) const {
-      VectorColumn col;
-      get_column(idx, col);
-      return col.size();
+      return is_identity(idx) ? 1 : matrix[idx].size();
     }
 
     index_t get_max_column_entries() const {
@@ -125,11 +227,10 @@ namespace stn {
       size_t max_row_entries = 0;
       const index_t n_columns = get_n_columns();
       std::vector< std::vector< index_t > > transposed_matrix(n_columns);
-      VectorColumn temp_col;
       for(index_t idx = 0; idx < n_columns; ++idx) {
-        get_column(idx, temp_col);
-        for(index_t idx = 0; idx < (index_t) temp_col.size(); ++idx)
-          transposed_matrix[temp_col[idx]].push_back(idx);
+        const ColumnSpan<column_index_t> col = get_span(idx);
+        for(index_t idx = 0; idx < (index_t) col.size(); ++idx)
+          transposed_matrix[col[idx]].push_back(idx);
       }
 
       for(index_t idx = 0; idx < n_columns; ++idx)
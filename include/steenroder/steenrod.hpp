@@ -8,18 +8,33 @@
 #include "sorted_matrix.hpp"
 #include "sorted_bars.hpp"
 #include "vector_column.hpp"
+#include "column_operations.hpp"
 #include "reduction.hpp"
+#include "representative_writer.hpp"
 
 namespace stn {
 
   template<typename ReductionAlgorithm, typename ColumnType = VectorColumn>
   class Steenrod {
   private:
+    using column_index_t = typename ViewMatrix<ColumnType>::column_index_t;
+
+    // Columns reused by steenrod_square, so that its loop over pairs of
+    // cells does not allocate
+    struct SquareBuffers {
+      std::vector<bool> permutations;
+      ColumnType a_U_b;
+      ColumnType a_bar;
+      ColumnType b_bar;
+      ColumnType a_bar_U_b_bar;
+    };
+
     ReductionAlgorithm reduction;
     const dimension_t d;
     const dimension_t k;
     const index_t n_cells;
     const SimplexMatrix<ColumnType>& simplex_matrix;
+    thread_local_storage<SquareBuffers> square_buffers;
 
     bool calculate_index(const index_t idx_vertex, const ColumnType& a_U_b,
                          const ColumnType& bar, const ColumnType& a_bar_U_b_bar) {
@@ -41,22 +56,35 @@ namespace stn {
       , k(k_in)
       , n_cells(n_cells_in)
       , simplex_matrix(simplex_matrix)
+      , square_buffers()
     {}
 
+    // When writers are given, the cocycles of dimension d and their Steenrod
+    // squares are streamed to them as they are computed. Steenrod squares are
+    // written before they are reduced by calculate_deaths.
     void compute(ViewFiniteBars<ColumnType>& cohomology_finite_bars,
                  ViewInfiniteBars<ColumnType>& cohomology_infinite_bars,
-                 Bars<ColumnType>& steenrod_bars) {
+                 Bars<ColumnType>& steenrod_bars,
+                 RepresentativeWriter* cocycle_writer = nullptr,
+                 RepresentativeWriter* steenrod_writer = nullptr) {
+      const index_t first_written_bar = steenrod_writer ? steenrod_writer->get_n_bars() : 0;
       index_t n_bars = 0;
+      ColumnType steenrod_representative;
       index_t start = cohomology_finite_bars.get_start_dimension(d);
       index_t end = start + cohomology_finite_bars.get_n_columns_per_dimension(d);
       for(index_t idx_view = start; idx_view < end; ++idx_view) {
         index_t idx_col = cohomology_finite_bars.get_view(idx_view);
         index_t birth = cohomology_finite_bars.get_birth(idx_col);
-        ColumnType cohomology_representative;
-        cohomology_finite_bars.get_column(idx_col, cohomology_representative);
-        ColumnType steenrod_representative;
+        const ColumnSpan<column_index_t> cohomology_representative =
+          cohomology_finite_bars.get_span(idx_col);
+        if(cocycle_writer)
+          cocycle_writer->write(d, birth, cohomology_finite_bars.get_death(idx_col),
+                                cohomology_representative);
+        steenrod_representative.clear();
         steenrod_square(cohomology_representative, birth, steenrod_representative);
         if(steenrod_representative.size()) {
+          if(steenrod_writer)
+            steenrod_writer->write(d + k, birth, -1, steenrod_representative);
           steenrod_bars.set_column(n_bars, steenrod_representative);
           steenrod_bars.set_birth(n_bars, birth);
           ++n_bars;
@@ -69,12 +97,16 @@ namespace stn {
       for(index_t idx_view = start; idx_view < end; ++idx_view) {
         index_t idx_col = cohomology_infinite_bars.get_view(idx_view);
         index_t birth = cohomology_infinite_bars.get_birth(idx_col);
-        ColumnType cohomology_representative;
-        cohomology_infinite_bars.get_column(idx_col, cohomology_representative);
-        ColumnType steenrod_representative;
+        const ColumnSpan<column_index_t> cohomology_representative =
+          cohomology_infinite_bars.get_span(idx_col);
+        if(cocycle_writer)
+          cocycle_writer->write(d, birth, -1, cohomology_representative);
+        steenrod_representative.clear();
         steenrod_square(cohomology_representative, birth, steenrod_representative);
 
         if(steenrod_representative.size()) {
+          if(steenrod_writer)
+            steenrod_writer->write(d + k, birth, -1, steenrod_representative);
           steenrod_bars.set_column(n_bars, steenrod_representative);
           steenrod_bars.set_birth(n_bars, birth);
           ++n_bars;
@@ -85,13 +117,27 @@ namespace stn {
       steenrod_bars.set_n_columns_per_dimension(0, n_bars);
 
       calculate_deaths(cohomology_finite_bars, steenrod_bars);
+
+      if(steenrod_writer) {
+        for(index_t idx_bar = 0; idx_bar < n_bars; ++idx_bar)
+          steenrod_writer->set_death(first_written_bar + idx_bar,
+                                     steenrod_bars.get_death(idx_bar));
+      }
     }
 
-    void steenrod_square(const ColumnType& cohomology_representative,
+    template<typename Column>
+    void steenrod_square(const Column& cohomology_representative,
                          const index_t birth,
                          ColumnType& steenrod_representative) {
-      ColumnType a, b;
-      std::vector<bool> permutations(cohomology_representative.size());
+      SquareBuffers& buffers = square_buffers();
+      std::vector<bool>& permutations = buffers.permutations;
+      ColumnSpan<column_index_t> a, b;
+      ColumnType& a_U_b = buffers.a_U_b;
+      ColumnType& a_bar = buffers.a_bar;
+      ColumnType& b_bar = buffers.b_bar;
+      ColumnType& a_bar_U_b_bar = buffers.a_bar_U_b_bar;
+
+      permutations.assign(cohomology_representative.size(), false);
       std::fill(permutations.end() - 2, permutations.end(), true);
 
       do {
@@ -101,23 +147,23 @@ namespace stn {
             if(first) {
               first = false;
               index_t idx_a = n_cells - 1 - cohomology_representative[i];
-              simplex_matrix.get_column(idx_a, a);
+              a = simplex_matrix.get_span(idx_a);
             }
             else {
               index_t idx_b = n_cells - 1 - cohomology_representative[i];
-              simplex_matrix.get_column(idx_b, b);
+              b = simplex_matrix.get_span(idx_b);
               break;
             }
           }
         }
 
-        ColumnType a_U_b = a | b;
+        column_union(a, b, a_U_b);
         if(k == a_U_b.size() - 1 - d) {
           index_t idx_a_U_b = simplex_matrix.is_in(0, d+k, a_U_b);
           if(idx_a_U_b != -1) {
-            ColumnType a_bar = b - a;
-            ColumnType b_bar = a - b;
-            ColumnType a_bar_U_b_bar = a_bar | b_bar;
+            column_difference(a, b, a_bar);
+            column_difference(b, a, b_bar);
+            column_union(a_bar, b_bar, a_bar_U_b_bar);
             index_t idx_vertex = 0;
 
             bool pos_a = calculate_index(idx_vertex, a_U_b, a_bar, a_bar_U_b_bar);
@@ -138,9 +184,7 @@ namespace stn {
               }
 
               if(purity) {
-                a_U_b = ColumnType(1, n_cells - idx_a_U_b - 1);
-                steenrod_representative |= a_U_b;
-
+                column_insert(steenrod_representative, n_cells - idx_a_U_b - 1);
               }
             }
           }
@@ -155,10 +199,10 @@ namespace stn {
       const index_t n_columns_R = cohomology_finite_bars.get_n_columns();
       const index_t n_columns_S = steenrod_bars.get_n_columns();
 
-      std::vector<index_t>& view = cohomology_finite_bars.get_view();
+      std::vector<column_index_t>& view = cohomology_finite_bars.get_view();
       index_t start = cohomology_finite_bars.get_start_dimension(d + k);
       index_t end = start + cohomology_finite_bars.get_n_columns_per_dimension(d + k);
-      view = std::vector<index_t>(view.begin() + start, view.begin() + end);
+      view = std::vector<column_index_t>(view.begin() + start, view.begin() + end);
 
       view.resize(view.size() + n_columns_S);
       std::iota(view.end() - n_columns_S, view.end(), n_columns_R);
@@ -178,7 +222,7 @@ namespace stn {
                 });
 
       const index_t n_columns = cohomology_finite_bars.get_n_columns();
-      std::vector<index_t> pivot_lookup(n_columns_R+n_columns_S, -1);
+      std::vector<column_index_t> pivot_lookup(n_columns_R+n_columns_S, -1);
 
       for(index_t idx_view = 0; idx_view < view.size() - n_columns_S; ++idx_view) {
         index_t idx_col = view[idx_view];
@@ -192,11 +236,6 @@ namespace stn {
       // for each column of S
       for(index_t idx_view_S = view.size() - n_columns_S;
           idx_view_S < view.size(); ++idx_view_S) {
-        ColumnType reduced_steenrod_representative;
-
-        steenrod_bars.get_column(view[idx_view_S] - n_columns_R,
-                                 reduced_steenrod_representative);
-
         index_t birth_S = steenrod_bars.get_birth(view[idx_view_S] - n_columns_R);
 
         bool first_reduction = true;
@@ -209,16 +248,14 @@ namespace stn {
 
             index_t pivot = steenrod_bars.get_max_index(idx_col - n_columns_R);
             while(pivot != -1 && pivot_lookup[pivot] && pivot_lookup[pivot] != -1) {
-              ColumnType temp_col;
-
               if(pivot_lookup[pivot] < view[n_columns_R_birth_S]) {
-                cohomology_finite_bars.get_column(pivot_lookup[pivot], temp_col);
-                steenrod_bars.add(temp_col, idx_col - n_columns_R);
+                steenrod_bars.add(cohomology_finite_bars.get_span(pivot_lookup[pivot]),
+                                  idx_col - n_columns_R);
 
               }
               else if(pivot_lookup[pivot] >= n_columns_R && pivot_lookup[pivot] < idx_col) {
-                steenrod_bars.get_column(pivot_lookup[pivot] - n_columns_R, temp_col);
-                steenrod_bars.add(temp_col, idx_col - n_columns_R);
+                steenrod_bars.add(pivot_lookup[pivot] - n_columns_R,
+                                  idx_col - n_columns_R);
               }
               else {
                 break;
@@ -0,0 +1,237 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "commons.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STN_HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace stn {
+
+  // Symmetric difference of two strictly increasing ranges of row indices,
+  // the addition of two columns over Z2. The kernels write to out, which must
+  // have room for (a_end - a) + (b_end - b) entries, and return the end of
+  // the result. The vector kernels only copy whole vectors that fall between
+  // two entries of the other range and are slower than the standard merge
+  // on interleaved ranges, so symmetric_difference only uses them when the
+  // ranges look like long runs.
+
+  enum class SimdLevel { Scalar, SSE2, AVX2, AVX512 };
+
+  // Branchless merge: the smaller head is always written and only kept when
+  // the heads differ
+  template<typename IndexType>
+  inline IndexType* scalar_symmetric_difference(const IndexType* a, const IndexType* a_end,
+                                                const IndexType* b, const IndexType* b_end,
+                                                IndexType* out) {
+    while(a != a_end && b != b_end) {
+      const IndexType x = *a;
+      const IndexType y = *b;
+      *out = x < y ? x : y;
+      out += x != y;
+      a += x <= y;
+      b += y <= x;
+    }
+    out = std::copy(a, a_end, out);
+    return std::copy(b, b_end, out);
+  }
+
+#ifdef STN_HAS_X86_SIMD
+  // When the next width entries of one range are all below the head of the
+  // other, they are part of the result and copied as one vector. Otherwise
+  // up to width steps of the scalar merge are taken. Long runs, as when a
+  // short column is added to a long one, then move width entries at a time.
+#define STN_SIMD_KERNEL(name, isa, IndexType, width, load, store)              \
+  __attribute__((target(isa)))                                                 \
+  inline IndexType* name(const IndexType* a, const IndexType* a_end,           \
+                         const IndexType* b, const IndexType* b_end,           \
+                         IndexType* out) {                                     \
+    while(a != a_end && b != b_end) {                                          \
+      if(a_end - a >= width && a[width - 1] < *b) {                            \
+        store(out, load(a));                                                   \
+        out += width;                                                          \
+        a += width;                                                            \
+      } else if(b_end - b >= width && b[width - 1] < *a) {                     \
+        store(out, load(b));                                                   \
+        out += width;                                                          \
+        b += width;                                                            \
+      } else {                                                                 \
+        for(int step = 0; step < width && a != a_end && b != b_end; ++step) {  \
+          const IndexType x = *a;                                              \
+          const IndexType y = *b;                                              \
+          *out = x < y ? x : y;                                                \
+          out += x != y;                                                       \
+          a += x <= y;                                                         \
+          b += y <= x;                                                         \
+        }                                                                      \
+      }                                                                        \
+    }                                                                          \
+    out = std::copy(a, a_end, out);                                            \
+    return std::copy(b, b_end, out);                                           \
+  }
+
+#define STN_SSE_LOAD(ptr) _mm_loadu_si128((const __m128i*) (ptr))
+#define STN_SSE_STORE(ptr, v) _mm_storeu_si128((__m128i*) (ptr), v)
+#define STN_AVX2_LOAD(ptr) _mm256_loadu_si256((const __m256i*) (ptr))
+#define STN_AVX2_STORE(ptr, v) _mm256_storeu_si256((__m256i*) (ptr), v)
+#define STN_AVX512_LOAD(ptr) _mm512_loadu_si512((const void*) (ptr))
+#define STN_AVX512_STORE(ptr, v) _mm512_storeu_si512((void*) (ptr), v)
+
+  STN_SIMD_KERNEL(sse2_symmetric_difference, "sse2", int64_t, 2,
+                  STN_SSE_LOAD, STN_SSE_STORE)
+  STN_SIMD_KERNEL(sse2_symmetric_difference, "sse2", int32_t, 4,
+                  STN_SSE_LOAD, STN_SSE_STORE)
+  STN_SIMD_KERNEL(avx2_symmetric_difference, "avx2", int64_t, 4,
+                  STN_AVX2_LOAD, STN_AVX2_STORE)
+  STN_SIMD_KERNEL(avx2_symmetric_difference, "avx2", int32_t, 8,
+                  STN_AVX2_LOAD, STN_AVX2_STORE)
+  STN_SIMD_KERNEL(avx512_symmetric_difference, "avx512f", int64_t, 8,
+                  STN_AVX512_LOAD, STN_AVX512_STORE)
+  STN_SIMD_KERNEL(avx512_symmetric_difference, "avx512f", int32_t, 16,
+                  STN_AVX512_LOAD, STN_AVX512_STORE)
+
+#undef STN_SIMD_KERNEL
+#undef STN_SSE_LOAD
+#undef STN_SSE_STORE
+#undef STN_AVX2_LOAD
+#undef STN_AVX2_STORE
+#undef STN_AVX512_LOAD
+#undef STN_AVX512_STORE
+#endif
+
+  // Highest level supported by the processor, detected once
+  inline SimdLevel get_simd_level() {
+#ifdef STN_HAS_X86_SIMD
+    static const SimdLevel level = []() {
+      __builtin_cpu_init();
+      if(__builtin_cpu_supports("avx512f"))
+        return SimdLevel::AVX512;
+      if(__builtin_cpu_supports("avx2"))
+        return SimdLevel::AVX2;
+      if(__builtin_cpu_supports("sse2"))
+        return SimdLevel::SSE2;
+      return SimdLevel::Scalar;
+    }();
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+  }
+
+  template<typename IndexType>
+  struct SymmetricDifference {
+    typedef IndexType* (*Kernel)(const IndexType*, const IndexType*,
+                                 const IndexType*, const IndexType*, IndexType*);
+
+    // Kernel of the given level, or nullptr when the processor or the
+    // index type does not support it
+    static Kernel get_kernel(const SimdLevel level) {
+      if(level == SimdLevel::Scalar)
+        return scalar_symmetric_difference<IndexType>;
+      if(level > get_simd_level())
+        return nullptr;
+      return get_vector_kernel(level);
+    }
+
+  private:
+    static Kernel select(void*, const SimdLevel) {
+      return nullptr;
+    }
+
+#ifdef STN_HAS_X86_SIMD
+    static Kernel select_x86(const SimdLevel level) {
+      switch(level) {
+      case SimdLevel::SSE2:
+        return sse2_symmetric_difference;
+      case SimdLevel::AVX2:
+        return avx2_symmetric_difference;
+      case SimdLevel::AVX512:
+        return avx512_symmetric_difference;
+      default:
+        return nullptr;
+      }
+    }
+
+    static Kernel select(int64_t*, const SimdLevel level) {
+      return select_x86(level);
+    }
+
+    static Kernel select(int32_t*, const SimdLevel level) {
+      return select_x86(level);
+    }
+#endif
+
+    static Kernel get_vector_kernel(const SimdLevel level) {
+      return select((IndexType*) nullptr, level);
+    }
+
+  public:
+    // Number of entries a kernel of the given level copies at once
+    static index_t get_width(const SimdLevel level) {
+      switch(level) {
+      case SimdLevel::SSE2:
+        return 16 / sizeof(IndexType);
+      case SimdLevel::AVX2:
+        return 32 / sizeof(IndexType);
+      case SimdLevel::AVX512:
+        return 64 / sizeof(IndexType);
+      default:
+        return 1;
+      }
+    }
+  };
+
+  // Whether the longer range has runs of about width entries that fall
+  // between two entries of the other one. Probes n_probes evenly spaced
+  // blocks of half that length, each with a binary search in the other
+  // range, and expects a few of them to be free of its entries. Interleaved
+  // ranges rarely have one, and ranges too short to repay the probes are
+  // left to the standard merge.
+  template<typename IndexType>
+  inline bool has_long_runs(const IndexType* a, const IndexType* a_end,
+                            const IndexType* b, const IndexType* b_end,
+                            const index_t width) {
+    const index_t n_probes = 8;
+    const index_t probe_length = std::max<index_t>(4, width / 2);
+    if(a_end - a < b_end - b) {
+      std::swap(a, b);
+      std::swap(a_end, b_end);
+    }
+    const index_t n_rows = a_end - a;
+    if(width < 4 || n_rows < 4 * n_probes * probe_length || b == b_end)
+      return false;
+
+    index_t n_free = 0;
+    for(index_t probe = 0; probe < n_probes; ++probe) {
+      const IndexType* block = a + probe * (n_rows - probe_length) / (n_probes - 1);
+      const IndexType* next = std::lower_bound(b, b_end, block[0]);
+      n_free += next == b_end || *next > block[probe_length - 1];
+    }
+    return n_free >= 3;
+  }
+
+  // Uses the best vector kernel available for IndexType on this processor
+  // when the ranges have long runs, and the standard merge otherwise
+  template<typename IndexType>
+  inline IndexType* symmetric_difference(const IndexType* a, const IndexType* a_end,
+                                         const IndexType* b, const IndexType* b_end,
+                                         IndexType* out) {
+    typedef SymmetricDifference<IndexType> Kernels;
+    static const SimdLevel level = Kernels::get_kernel(get_simd_level())
+      ? get_simd_level() : SimdLevel::Scalar;
+    static const typename Kernels::Kernel kernel = Kernels::get_kernel(level);
+    static const index_t width = Kernels::get_width(level);
+    if(has_long_runs(a, a_end, b, b_end, width))
+      return kernel(a, a_end, b, b_end, out);
+    return std::set_symmetric_difference(a, a_end, b, b_end, out);
+  }
+
+} // namespace stn
@@ -8,16 +8,25 @@
 #include <vector>
 
 #include "commons.hpp"
+#include "column_operations.hpp"
 
 namespace stn {
 
-  class VectorColumn :
-    public std::vector<index_t> {
+  // Sorted column of row indices stored as IndexType. Smaller index types
+  // save memory on complexes with few enough cells.
+  template<typename IndexType>
+  class BasicVectorColumn :
+    public std::vector<IndexType> {
   private:
-    using Base = std::vector<index_t>;
-    using Base::Base;
+    using Base = std::vector<IndexType>;
 
   public:
+    using Base::Base;
+    using Base::size;
+    using Base::begin;
+    using Base::end;
+    using Base::swap;
+
     index_t get_max() {
       if(size()) {
         return Base::operator[](size() - 1);
@@ -27,63 +36,31 @@ namespace stn {
       }
     }
 
-    VectorColumn& operator+=(const VectorColumn& right) {
-      VectorColumn temp;
-
-      size_t new_size = right.size() + size();
-      if(new_size > temp.size()) {
-        temp.resize(new_size);
-      }
-
-      std::vector<index_t>::iterator col_end =
-        std::set_symmetric_difference(begin(), end(),
-                                      right.begin(), right.end(),
-                                      temp.begin());
-
-      temp.erase(col_end, temp.end());
+    BasicVectorColumn& operator+=(const BasicVectorColumn& right) {
+      BasicVectorColumn temp;
+      column_sum(*this, right, temp);
       swap(temp);
       return *this;
     }
 
-    VectorColumn& operator-=(const VectorColumn& right) {
-      VectorColumn temp;
-
-      size_t new_size = right.size() + size();
-      if(new_size > temp.size()) {
-        temp.resize(new_size);
-      }
-
-      std::vector<index_t>::iterator col_end =
-        std::set_difference(begin(), end(),
-                            right.begin(), right.end(),
-                            temp.begin());
-
-      temp.erase(col_end, temp.end());
+    BasicVectorColumn& operator-=(const BasicVectorColumn& right) {
+      BasicVectorColumn temp;
+      column_difference(*this, right, temp);
       swap(temp);
       return *this;
     }
 
-    VectorColumn& operator |=(const VectorColumn& right) {
-      VectorColumn temp;
-
-      size_t new_size = right.size() + size();
-      if(new_size > temp.size()) {
-        temp.resize(new_size);
-      }
-
-      std::vector<index_t>::iterator col_end =
-        std::set_union(begin(), end(),
-                       right.begin(), right.end(),
-                       temp.begin());
-
-      temp.erase(col_end, temp.end());
+    BasicVectorColumn& operator |=(const BasicVectorColumn& right) {
+      BasicVectorColumn temp;
+      column_union(*this, right, temp);
       swap(temp);
       return *this;
     }
 
   };
 
-  std::ostream& operator<<(std::ostream& os, const VectorColumn& col) {
+  template<typename IndexType>
+  std::ostream& operator<<(std::ostream& os, const BasicVectorColumn<IndexType>& col) {
     os << "[";
     for (int i = 0; i < col.size(); ++i) {
       os << col[i];
@@ -95,22 +72,31 @@ namespace stn {
   }
 
 
-  VectorColumn operator+(const VectorColumn& right, const VectorColumn& left) {
-    VectorColumn res = left;
+  template<typename IndexType>
+  BasicVectorColumn<IndexType> operator+(const BasicVectorColumn<IndexType>& right,
+                                         const BasicVectorColumn<IndexType>& left) {
+    BasicVectorColumn<IndexType> res = left;
     res += right;
     return res;
   }
 
-  VectorColumn operator-(const VectorColumn& right, const VectorColumn& left) {
-    VectorColumn res = left;
+  template<typename IndexType>
+  BasicVectorColumn<IndexType> operator-(const BasicVectorColumn<IndexType>& right,
+                                         const BasicVectorColumn<IndexType>& left) {
+    BasicVectorColumn<IndexType> res = left;
     res -= right;
     return res;
   }
 
-  VectorColumn operator|(const VectorColumn& right, const VectorColumn& left) {
-    VectorColumn res = left;
+  template<typename IndexType>
+  BasicVectorColumn<IndexType> operator|(const BasicVectorColumn<IndexType>& right,
+                                         const BasicVectorColumn<IndexType>& left) {
+    BasicVectorColumn<IndexType> res = left;
     res |= right;
     return res;
   }
 
+  typedef BasicVectorColumn<index_t> VectorColumn;
+  typedef BasicVectorColumn<int32_t> VectorColumn32;
+
 } // namespace stn
@@ -5,15 +5,19 @@
 #include "input.in"
 #include "steenroder/args_parser.hpp"
 #include "steenroder/commons.hpp"
+#include "steenroder/async_writer.hpp"
 
 #include <steenroder/sparse_matrix.hpp>
 #include <steenroder/vector_column.hpp>
+#include <steenroder/small_column.hpp>
 #include <steenroder/boundary_matrix.hpp>
 #include <steenroder/simplex_matrix.hpp>
+#include <steenroder/mapped_matrix.hpp>
 #include <steenroder/bars.hpp>
 #include <steenroder/reduction.hpp>
 #include <steenroder/homology.hpp>
 #include <steenroder/steenrod.hpp>
+#include <steenroder/representative_writer.hpp>
 #include <steenroder/sorted_matrix.hpp>
 #include <steenroder/sorted_bars.hpp>
 
@@ -26,7 +30,10 @@ void read(T& data, const std::string& input_filename, bool use_binary) {
   if(use_binary) {
     read_successful = data.load_binary(input_filename);
   } else {
-    read_successful = data.load_ascii(input_filename);
+    ParseStatistics stats;
+    read_successful = data.load_ascii(input_filename, stats);
+    if(read_successful)
+      std::cout << stats << std::endl;
   }
 
   if(!read_successful) {
@@ -34,23 +41,36 @@ void read(T& data, const std::string& input_filename, bool use_binary) {
   }
 }
 
+// Reads the input once and fills both the primal matrix and its anti-transpose.
+// Only dual columns of dimension in [min_dual_dimension, max_dual_dimension]
+// are filled. Binary primal columns of dimension above max_dimension are
+// left empty.
 template<class T>
-void read_dual(T& data, const std::string& input_filename, bool use_binary) {
+bool read_with_dual(T& data, T& dual_data, const std::string& input_filename,
+                    bool use_binary, const dimension_t max_dimension,
+                    const dimension_t min_dual_dimension,
+                    const dimension_t max_dual_dimension) {
   bool read_successful;
 
   if(use_binary) {
-    read_successful = data.load_binary_dual(input_filename);
+    read_successful = data.load_binary(input_filename, dual_data, 0, max_dimension,
+                                       min_dual_dimension, max_dual_dimension);
   } else {
-    read_successful = data.load_ascii_dual(input_filename);
+    ParseStatistics stats;
+    read_successful = data.load_ascii(input_filename, dual_data, min_dual_dimension,
+                                      max_dual_dimension, stats);
+    if(read_successful)
+      std::cout << stats << std::endl;
   }
 
   if(!read_successful) {
     std::cerr << "Error opening file " << input_filename << std::endl;
   }
+  return read_successful;
 }
 
 template<class T>
-void write(T& data, const std::string& name,
+void write(const T& data, const std::string& name,
            const std::string& output_filename, bool use_binary) {
   if(use_binary) {
     data.save_binary(name, output_filename);
@@ -59,17 +79,62 @@ void write(T& data, const std::string& name,
   }
 }
 
+// Queues data to be written in the background if it is selected. data is
+// shared with the writer, so it must stay unchanged until writer.wait().
+template<class T>
+void write(AsyncWriter& writer, const T& data, const std::string& name,
+           const std::string& output_filename, bool use_binary) {
+  if(!writer.is_selected(name))
+    return;
+
+  const T* shared_data = &data;
+  writer.submit([=]() {
+      write(*shared_data, name, output_filename, use_binary);
+    });
+}
+
+// Same, but the writer holds its own snapshot so data can be modified
+// right away.
+template<class T>
+void write_snapshot(AsyncWriter& writer, const T& data, const std::string& name,
+                    const std::string& output_filename, bool use_binary) {
+  if(!writer.is_selected(name))
+    return;
+
+  std::shared_ptr<const T> snapshot = std::make_shared<const T>(data);
+  writer.submit([=]() {
+      write(*snapshot, name, output_filename, use_binary);
+    });
+}
+
+// Input matrices are consumed right after being queued, so the writer gets a
+// snapshot of them. A mapped matrix is only ever read, so it is shared.
+template<typename ColumnType>
+void write_input(AsyncWriter& writer, const ViewMatrix<ColumnType>& data,
+                 const std::string& name, const std::string& output_filename,
+                 bool use_binary) {
+  write_snapshot(writer, data, name, output_filename, use_binary);
+}
+
+template<typename ColumnType>
+void write_input(AsyncWriter& writer, const MappedViewMatrix<ColumnType>& data,
+                 const std::string& name, const std::string& output_filename,
+                 bool use_binary) {
+  write(writer, data, name, output_filename, use_binary);
+}
+
 template<typename ColumnType = VectorColumn>
 void write_pairs(const ViewFiniteBars<ColumnType>& finite_bars,
                  const ViewInfiniteBars<ColumnType>& infinite_bars,
                  const std::string& output_filename, bool use_binary,
-                 const std::string& prefix) {
+                 const std::string& prefix,
+                 const dimension_t min_dim, const dimension_t max_dim) {
   std::string filename = output_filename + "_" + prefix +"_pairs.dat";
 
   if(use_binary) {
-    save_pairs_binary(filename, finite_bars, infinite_bars);
+    save_pairs_binary(filename, finite_bars, infinite_bars, min_dim, max_dim);
   } else {
-    save_pairs_ascii(filename, finite_bars, infinite_bars);
+    save_pairs_ascii(filename, finite_bars, infinite_bars, min_dim, max_dim);
   }
 }
 
@@ -102,56 +167,162 @@ void write_pairs(const Bars<ColumnType>& bars,
 }
 
 
-void compute_steenrod_barcodes(const std::string& input_filename,
+template<typename BoundaryMatrixType, typename ColumnType>
+void compute_steenrod_barcodes(BoundaryMatrixType& boundary_matrix,
+                               ViewMatrix<ColumnType>& dual_boundary_matrix,
+                               AsyncWriter& writer,
                                const std::string& output_filename,
-                               const bool use_binary) {
-  const dimension_t d = 1;
-  const dimension_t k = 1;
-
-  ViewMatrix<VectorColumn> boundary_matrix;
-  read(boundary_matrix, input_filename, use_binary);
-  write(boundary_matrix, "boundary", output_filename, use_binary);
-
-  SimplexMatrix<VectorColumn> simplex_matrix(boundary_matrix, d, d + k);
-  write(simplex_matrix, "simplex", output_filename, use_binary);
-
-  // // Need to delete boundary_matrix to release memory
+                               const bool use_binary,
+                               const bool use_reps,
+                               const bool use_freeze,
+                               const dimension_t d, const dimension_t k) {
+  write_input(writer, boundary_matrix, "boundary", output_filename, use_binary);
+  write_input(writer, dual_boundary_matrix, "dual_boundary", output_filename, use_binary);
+
+  // A loaded boundary matrix is turned into the simplex matrix in place,
+  // a mapped one stays in its mapping
+  SimplexMatrix<ColumnType> simplex_matrix(std::move(boundary_matrix), d, d + k);
+  write(writer, simplex_matrix, "simplex", output_filename, use_binary);
 
   // Relative cohomology
-  ViewMatrix<VectorColumn> dual_boundary_matrix;
-  read_dual(dual_boundary_matrix, input_filename, use_binary);
-  write(dual_boundary_matrix, "dual_boundary", output_filename, use_binary);
   index_t n_dimensions = dual_boundary_matrix.get_n_dimensions();
   index_t n_cells = dual_boundary_matrix.get_n_columns();
 
-  ViewInfiniteBars<VectorColumn> dual_infinite_bars_matrix(n_cells, n_dimensions);
-  ViewFiniteBars<VectorColumn> dual_finite_bars_matrix(dual_boundary_matrix);
+  ViewInfiniteBars<ColumnType> dual_infinite_bars_matrix(n_cells, n_dimensions);
+  ViewFiniteBars<ColumnType> dual_finite_bars_matrix(std::move(dual_boundary_matrix));
 
-  Homology<TwistReduction<VectorColumn>> dual_homology;
+  Homology<ChunkReduction<ColumnType>> dual_homology;
   dual_homology.compute(dual_finite_bars_matrix, dual_infinite_bars_matrix);
 
-  write(dual_finite_bars_matrix, "dual_finite", output_filename, use_binary);
-  write(dual_infinite_bars_matrix, "dual_infinite", output_filename, use_binary);
+  write_snapshot(writer, dual_finite_bars_matrix, "dual_finite",
+                 output_filename, use_binary);
+  write_snapshot(writer, dual_infinite_bars_matrix, "dual_infinite",
+                 output_filename, use_binary);
 
   //dual_finite_bars_matrix.dualize();
   //dual_infinite_bars_matrix.dualize();
+  // Only the dual columns of dimension d - 1 to d + k are loaded, so the
+  // pairs are only complete from dimension d to d + k
   write_pairs(dual_finite_bars_matrix, dual_infinite_bars_matrix,
-              output_filename, use_binary, "dual");
+              output_filename, use_binary, "dual", d, d + k);
+
+  // Only the Steenrod squares read the reduced columns from here on
+  if(use_freeze) {
+    dual_finite_bars_matrix.freeze();
+    dual_infinite_bars_matrix.freeze();
+  }
 
   index_t n_finite_bars = dual_finite_bars_matrix.get_n_bars();
   index_t n_infinite_bars = dual_infinite_bars_matrix.get_n_bars();
-  Bars<VectorColumn> steenrod_bars_matrix(n_cells);
+  Bars<ColumnType> steenrod_bars_matrix(n_cells);
+
+  // Representatives are streamed while the Steenrod squares are computed
+  RepresentativeWriter cocycle_writer, steenrod_writer;
+  if(use_reps) {
+    if(!cocycle_writer.open(output_filename + "_dual_reps.dat")
+       || !steenrod_writer.open(output_filename + "_steenrod_reps.dat"))
+      std::cerr << "Error opening representatives files" << std::endl;
+  }
 
-  Steenrod<StandardReduction<VectorColumn>> steenrod(d, k, n_cells, simplex_matrix);
+  Steenrod<StandardReduction<ColumnType>, ColumnType> steenrod(d, k, n_cells,
+                                                               simplex_matrix);
   steenrod.compute(dual_finite_bars_matrix, dual_infinite_bars_matrix,
-                   steenrod_bars_matrix);
+                   steenrod_bars_matrix,
+                   cocycle_writer.is_open() ? &cocycle_writer : nullptr,
+                   steenrod_writer.is_open() ? &steenrod_writer : nullptr);
 
-  write(steenrod_bars_matrix, "steenrod", output_filename, use_binary);
+  if(cocycle_writer.is_open())
+    cocycle_writer.close();
+  if(steenrod_writer.is_open())
+    steenrod_writer.close();
+
+  write_snapshot(writer, steenrod_bars_matrix, "steenrod",
+                 output_filename, use_binary);
 
   //  steenrod_bars_matrix.dualize();
   steenrod_bars_matrix.dualize();
   write_pairs(steenrod_bars_matrix, output_filename, use_binary, "steenrod");
 
+  writer.wait();
+}
+
+// Returns false when the input cannot be read
+template<typename ColumnType>
+bool compute_steenrod_barcodes(const std::string& input_filename,
+                               const std::string& output_filename,
+                               const bool use_binary,
+                               const bool use_reps,
+                               const bool use_freeze,
+                               const std::string& dumps) {
+  const dimension_t d = 1;
+  const dimension_t k = 1;
+
+  AsyncWriter writer(dumps, {"boundary", "simplex", "dual_boundary",
+                            "dual_finite", "dual_infinite", "steenrod"});
+  ViewMatrix<ColumnType> dual_boundary_matrix;
+
+  // The Steenrod squares read cohomology bars of dimension d and d + k, whose
+  // reduction only needs the dual columns of dimension d - 1 to d + k
+  const dimension_t min_dual_dimension = d - 1;
+  const dimension_t max_dual_dimension = d + k;
+
+  // CSR input is read-only for the primal matrix, so it is used in place
+  if(use_binary && is_csr_file(input_filename)) {
+    MappedViewMatrix<ColumnType> boundary_matrix;
+    if(!boundary_matrix.load_binary(input_filename)
+       || !dual_boundary_matrix.load_binary_dual(input_filename, min_dual_dimension,
+                                                 max_dual_dimension)) {
+      std::cerr << "Error opening file " << input_filename << std::endl;
+      return false;
+    }
+    compute_steenrod_barcodes(boundary_matrix, dual_boundary_matrix, writer,
+                              output_filename, use_binary, use_reps, use_freeze, d, k);
+    return true;
+  }
+
+  // Simplices of dimension d + k only need boundaries of lower dimensions
+  const dimension_t max_dimension = writer.is_selected("boundary")
+    ? std::numeric_limits<dimension_t>::max() : d + k;
+  ViewMatrix<ColumnType> boundary_matrix;
+  if(!read_with_dual(boundary_matrix, dual_boundary_matrix, input_filename,
+                     use_binary, max_dimension, min_dual_dimension, max_dual_dimension))
+    return false;
+  compute_steenrod_barcodes(boundary_matrix, dual_boundary_matrix, writer,
+                            output_filename, use_binary, use_reps, use_freeze, d, k);
+  return true;
+}
+
+// Upper bound on the number of cells of the input, without parsing it. An
+// ascii column takes at least two bytes.
+index_t get_max_n_cells(const std::string& input_filename, const bool use_binary) {
+  index_t n_cells = std::numeric_limits<index_t>::max();
+  if(use_binary) {
+    MappedFile file;
+    if(file.open(input_filename, false))
+      read_binary_n_columns(file, n_cells);
+  } else {
+    std::ifstream input_stream(input_filename.c_str(),
+                               std::ios_base::binary | std::ios_base::ate);
+    if(input_stream.good())
+      n_cells = (index_t) input_stream.tellg() / 2 + 1;
+  }
+  return n_cells;
+}
+
+// Picks 32 bit indices when they are enough. Steenrod indexes the
+// cohomology and Steenrod columns together, hence the factor 2. Columns of
+// low dimensional cells fit in SmallColumn without allocating.
+bool compute_steenrod_barcodes(const std::string& input_filename,
+                               const std::string& output_filename,
+                               const bool use_binary,
+                               const bool use_reps,
+                               const bool use_freeze,
+                               const std::string& dumps) {
+  if(get_max_n_cells(input_filename, use_binary) <= std::numeric_limits<int32_t>::max() / 2)
+    return compute_steenrod_barcodes<SmallColumn32>(input_filename, output_filename,
+                                                    use_binary, use_reps, use_freeze, dumps);
+  return compute_steenrod_barcodes<SmallColumn>(input_filename, output_filename,
+                                                use_binary, use_reps, use_freeze, dumps);
 }
 
 
@@ -165,10 +336,17 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
-  bool use_binary = false;
-  compute_steenrod_barcodes(args.input_filename,
-                            args.output_filename,
-                            use_binary);
+  if(args.threads > 0)
+    omp_set_num_threads(args.threads);
+
+  bool use_binary = args.binary;
+  if(!compute_steenrod_barcodes(args.input_filename,
+                                args.output_filename,
+                                use_binary,
+                                args.reps,
+                                args.freeze,
+                                args.dumps))
+    return 1;
 
   return 0;
 }
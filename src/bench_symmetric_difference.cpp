@@ -0,0 +1,150 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <steenroder/commons.hpp>
+#include <steenroder/symmetric_difference.hpp>
+
+using namespace stn;
+
+// Compares the symmetric difference kernels, and symmetric_difference which
+// picks one of them or the standard merge, with std::set_symmetric_difference
+// on random columns of n_rows entries, of which a fraction overlap is shared
+// by both columns. Rows are drawn in runs of consecutive indices, so that the
+// columns interleave entry by entry for a run length of 1 and in longer
+// stretches otherwise.
+
+static const char* level_names[] = {"scalar", "sse2", "avx2", "avx512"};
+
+// Keeps the additions from being optimized away
+static volatile ptrdiff_t n_result_rows = 0;
+
+template<typename IndexType>
+void make_columns(const size_t n_rows, const double overlap, const size_t run_length,
+                  std::mt19937_64& generator,
+                  std::vector<IndexType>& a, std::vector<IndexType>& b) {
+  const size_t n_runs = n_rows / run_length;
+  const size_t n_shared = overlap * n_runs;
+  std::vector<IndexType> runs(4 * n_runs);
+  for(size_t idx = 0; idx < runs.size(); ++idx)
+    runs[idx] = (IndexType) (idx * run_length);
+  std::shuffle(runs.begin(), runs.end(), generator);
+
+  a.clear();
+  b.clear();
+  for(size_t idx = 0; idx < 2 * n_runs - n_shared; ++idx) {
+    for(size_t row = runs[idx]; row < runs[idx] + run_length; ++row) {
+      if(idx < n_runs)
+        a.push_back((IndexType) row);
+      if(idx < n_shared || idx >= n_runs)
+        b.push_back((IndexType) row);
+    }
+  }
+  std::sort(a.begin(), a.end());
+  std::sort(b.begin(), b.end());
+}
+
+template<typename IndexType, typename Add>
+double time_add(const std::vector<IndexType>& a, const std::vector<IndexType>& b,
+                std::vector<IndexType>& out, const size_t n_repeats, Add add) {
+  const auto start = std::chrono::steady_clock::now();
+  for(size_t repeat = 0; repeat < n_repeats; ++repeat)
+    n_result_rows = add(a.data(), a.data() + a.size(), b.data(), b.data() + b.size(),
+                        out.data()) - out.data();
+  const auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(stop - start).count() / n_repeats;
+}
+
+// Prints one line of timings and checks every kernel against the STL
+template<typename IndexType>
+bool run_case(const size_t n_rows, const double overlap, const size_t run_length,
+              std::mt19937_64& generator) {
+  typedef SymmetricDifference<IndexType> Kernels;
+  std::vector<IndexType> a, b;
+  make_columns(n_rows, overlap, run_length, generator, a, b);
+  std::vector<IndexType> expected(a.size() + b.size());
+  expected.erase(std::set_symmetric_difference(a.begin(), a.end(), b.begin(), b.end(),
+                                               expected.begin()),
+                 expected.end());
+
+  const size_t n_repeats = std::max<size_t>(16, (1 << 24) / n_rows);
+  std::vector<IndexType> out(a.size() + b.size());
+  std::printf("%8zu %8.2f %8zu %10.1f", n_rows, overlap, run_length,
+              time_add(a, b, out, n_repeats,
+                       [](const IndexType* a, const IndexType* a_end,
+                          const IndexType* b, const IndexType* b_end, IndexType* out) {
+                         return std::set_symmetric_difference(a, a_end, b, b_end, out);
+                       }));
+
+  bool valid = true;
+  for(int level = 0; level <= (int) SimdLevel::AVX512; ++level) {
+    typename Kernels::Kernel kernel = Kernels::get_kernel((SimdLevel) level);
+    if(!kernel) {
+      std::printf(" %10s", "-");
+      continue;
+    }
+
+    std::fill(out.begin(), out.end(), -1);
+    IndexType* out_end = kernel(a.data(), a.data() + a.size(),
+                                b.data(), b.data() + b.size(), out.data());
+    if(out_end - out.data() != (ptrdiff_t) expected.size()
+       || !std::equal(expected.begin(), expected.end(), out.data())) {
+      std::printf(" %10s", "WRONG");
+      valid = false;
+      continue;
+    }
+    std::printf(" %10.1f", time_add(a, b, out, n_repeats, kernel));
+  }
+
+  std::fill(out.begin(), out.end(), -1);
+  IndexType* out_end = symmetric_difference(a.data(), a.data() + a.size(),
+                                            b.data(), b.data() + b.size(), out.data());
+  if(out_end - out.data() != (ptrdiff_t) expected.size()
+     || !std::equal(expected.begin(), expected.end(), out.data())) {
+    std::printf(" %10s", "WRONG");
+    valid = false;
+  } else {
+    std::printf(" %10.1f", time_add(a, b, out, n_repeats, symmetric_difference<IndexType>));
+  }
+  std::printf("\n");
+  return valid;
+}
+
+template<typename IndexType>
+bool run(const char* type_name) {
+  const size_t run_lengths[] = {1, 16};
+  const size_t sizes[] = {4, 16, 64, 256, 1024, 16384};
+  const double overlaps[] = {0., 0.25, 0.5, 0.9};
+  std::mt19937_64 generator(0);
+  bool valid = true;
+
+  std::printf("%s indices, ns per addition\n%8s %8s %8s %10s",
+              type_name, "n_rows", "overlap", "run", "std");
+  for(int level = 0; level <= (int) SimdLevel::AVX512; ++level)
+    std::printf(" %10s", level_names[level]);
+  std::printf(" %10s\n", "auto");
+
+  for(size_t run_length : run_lengths) {
+    for(size_t n_rows : sizes) {
+      if(n_rows < run_length)
+        continue;
+      for(double overlap : overlaps)
+        valid = run_case<IndexType>(n_rows, overlap, run_length, generator) && valid;
+    }
+  }
+  std::printf("\n");
+  return valid;
+}
+
+int main() {
+  std::printf("Selected level: %s\n\n", level_names[(int) get_simd_level()]);
+  bool valid = run<int64_t>("64 bit");
+  valid = run<int32_t>("32 bit") && valid;
+  return valid ? 0 : 1;
+}
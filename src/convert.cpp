@@ -0,0 +1,52 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#include "input.in"
+#include "steenroder/args_parser.hpp"
+#include "steenroder/commons.hpp"
+
+#include <steenroder/sparse_matrix.hpp>
+#include <steenroder/vector_column.hpp>
+#include <steenroder/boundary_matrix.hpp>
+
+using namespace stn;
+
+// Converts a PHAT ascii boundary matrix into the CSR or compressed binary layout
+void convert(const std::string& input_filename,
+             const std::string& output_filename,
+             const bool compress) {
+  BoundaryMatrix<VectorColumn> boundary_matrix;
+  ParseStatistics stats;
+  if(!boundary_matrix.load_ascii(input_filename, stats)) {
+    std::cerr << "Error opening file " << input_filename << std::endl;
+    return;
+  }
+  std::cout << stats << std::endl;
+
+  bool write_successful = compress ?
+    boundary_matrix.save_compressed(output_filename) :
+    boundary_matrix.save_binary(output_filename);
+  if(!write_successful) {
+    std::cerr << "Error writing file " << output_filename << std::endl;
+  }
+}
+
+
+int main(int argc, char* argv[]) {
+  using namespace stn;
+  STN_INSTRUMENT_ON("main", 0)
+
+  ArgsParser args(argc, argv);
+  if(args.help){
+    args.printUsage();
+    return 0;
+  }
+
+  if(args.threads > 0)
+    omp_set_num_threads(args.threads);
+
+  convert(args.input_filename, args.output_filename, args.compress);
+
+  return 0;
+}
@@ -10,6 +10,7 @@
 #include <steenroder/sparse_matrix.hpp>
 #include <steenroder/vector_column.hpp>
 #include <steenroder/boundary_matrix.hpp>
+#include <steenroder/external_dualize.hpp>
 
 using namespace stn;
 
@@ -20,7 +21,10 @@ void read(T& data, const std::string& input_filename, bool use_binary) {
   if(use_binary) {
     read_successful = data.load_binary(input_filename);
   } else {
-    read_successful = data.load_ascii(input_filename);
+    ParseStatistics stats;
+    read_successful = data.load_ascii(input_filename, stats);
+    if(read_successful)
+      std::cout << stats << std::endl;
   }
 
   if(!read_successful) {
@@ -29,7 +33,7 @@ void read(T& data, const std::string& input_filename, bool use_binary) {
 }
 
 template<class T>
-void write(T& data, const std::string& name,
+void write(const T& data, const std::string& name,
            const std::string& output_filename, bool use_binary) {
   if(use_binary) {
     data.save_binary(name, output_filename);
@@ -38,6 +42,17 @@ void write(T& data, const std::string& name,
   }
 }
 
+// Works from the files with at most memory_budget bytes of entries in memory
+void dualize_external(const std::string& input_filename,
+                      const std::string& output_filename,
+                      const bool use_binary,
+                      const size_t memory_budget) {
+  ExternalDualizer dualizer(memory_budget, output_filename + "_dualize_run_");
+  if(!dualizer.dualize(input_filename, output_filename + "_dualized.dat", use_binary)) {
+    std::cerr << "Error dualizing file " << input_filename << std::endl;
+  }
+}
+
 void dualize(const std::string& input_filename,
                                const std::string& output_filename,
                                const bool use_binary) {
@@ -60,8 +75,15 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
-  bool use_binary = false;
-  dualize(args.input_filename, args.output_filename, use_binary);
+  if(args.threads > 0)
+    omp_set_num_threads(args.threads);
+
+  bool use_binary = args.binary;
+  if(args.memory > 0)
+    dualize_external(args.input_filename, args.output_filename, use_binary,
+                     (size_t) args.memory << 20);
+  else
+    dualize(args.input_filename, args.output_filename, use_binary);
 
   return 0;
 }
@@ -0,0 +1,94 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <steenroder/ascii_reader.hpp>
+#include <steenroder/sorted_matrix.hpp>
+#include <steenroder/vector_column.hpp>
+
+using namespace stn;
+
+namespace {
+
+  const index_t n_lines = 700000;
+
+  // Writes n_lines columns, about 18 MB so that the file is parsed in
+  // parallel chunks, with line bad_line malformed unless it is -1
+  std::string write_file(const std::string& name, const index_t bad_line) {
+    const std::string filename = ::testing::TempDir() + name;
+    std::ofstream output(filename);
+    for(index_t line = 0; line < n_lines; ++line) {
+      if(line == bad_line)
+        output << "2 1000000 x 1000002\n";
+      else
+        output << "2 " << 1000000 + line << " " << 1000001 + line << " "
+               << 1000002 + line << "\n";
+    }
+    return filename;
+  }
+
+  std::string write_small_file(const std::string& name, const std::string& content) {
+    const std::string filename = ::testing::TempDir() + name;
+    std::ofstream output(filename);
+    output << content;
+    return filename;
+  }
+
+  bool read_file(const std::string& filename, std::vector<std::vector<index_t>>& columns) {
+    std::vector<index_t> attributes;
+    AsciiReader reader;
+    return reader.open(filename) && reader.read_columns(columns, attributes);
+  }
+
+}
+
+TEST(AsciiReader, ReadsLargeFile) {
+  omp_set_num_threads(4);
+  const std::string filename = write_file("ascii_reader_valid.phat", -1);
+  std::vector<std::vector<index_t>> columns;
+  EXPECT_TRUE(read_file(filename, columns));
+  ASSERT_EQ(n_lines, (index_t) columns.size());
+  for(index_t line = 0; line < n_lines; ++line) {
+    const std::vector<index_t> expected = {1000000 + line, 1000001 + line, 1000002 + line};
+    ASSERT_EQ(expected, columns[line]);
+  }
+  std::remove(filename.c_str());
+}
+
+// A thread parsing several chunks must not forget the failure of an earlier
+// one when a later one succeeds
+TEST(AsciiReader, RejectsLargeMalformedFile) {
+  omp_set_num_threads(4);
+  for(const index_t bad_line : {(index_t) 10, n_lines / 2, n_lines - 1}) {
+    const std::string filename = write_file("ascii_reader_malformed.phat", bad_line);
+    std::vector<std::vector<index_t>> columns;
+    EXPECT_FALSE(read_file(filename, columns)) << "malformed line " << bad_line;
+    std::remove(filename.c_str());
+  }
+}
+
+TEST(AsciiReader, RejectsNegativeNumbers) {
+  for(const char* content : {"0\n0\n1 -1 0\n", "-1\n0\n1 0 1\n"}) {
+    const std::string filename = write_small_file("ascii_reader_negative.phat", content);
+    std::vector<std::vector<index_t>> columns;
+    EXPECT_FALSE(read_file(filename, columns)) << content;
+    std::remove(filename.c_str());
+  }
+}
+
+// Rows must be indices of columns, or the anti-transpose cannot hold them
+TEST(AsciiReader, RejectsRowsOutOfRange) {
+  const std::string filename = write_small_file("ascii_reader_out_of_range.phat",
+                                                "0\n0\n1 0 3\n");
+  ViewMatrix<VectorColumn> primal_matrix, dual_matrix;
+  EXPECT_FALSE(primal_matrix.load_ascii(filename, dual_matrix));
+  EXPECT_FALSE(dual_matrix.load_ascii_dual(filename));
+  std::remove(filename.c_str());
+}
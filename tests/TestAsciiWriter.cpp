@@ -0,0 +1,101 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <steenroder/ascii_writer.hpp>
+#include <steenroder/boundary_matrix.hpp>
+#include <steenroder/sorted_matrix.hpp>
+#include <steenroder/vector_column.hpp>
+
+#include "simplex_boundary.hpp"
+
+using namespace stn;
+
+namespace {
+
+  std::string read_file(const std::string& filename) {
+    std::ifstream input_stream(filename.c_str(), std::ios_base::binary);
+    return std::string((std::istreambuf_iterator<char>(input_stream)),
+                       std::istreambuf_iterator<char>());
+  }
+
+  // Ranges shorter than a chunk, spanning several batches of chunks, and
+  // text put in between them
+  std::string write_ranges(const std::string& filename) {
+    AsciiWriter writer;
+    EXPECT_TRUE(writer.open(filename));
+    const index_t range_ends[] = {0, 10, 20000, 1000000, 1000001};
+    for(index_t idx = 1; idx < 5; ++idx) {
+      writer.put("# range ");
+      writer.put_index(idx);
+      writer.put('\n');
+      writer.write_range(range_ends[idx - 1], range_ends[idx],
+        [](AsciiBuffer& buffer, index_t begin, index_t end) {
+          for(index_t item = begin; item < end; ++item) {
+            buffer.put_index(item % 3 == 0 ? -item : item * item);
+            buffer.put('\n');
+          }
+        });
+    }
+    EXPECT_TRUE(writer.close());
+    const std::string content = read_file(filename);
+    std::remove(filename.c_str());
+    return content;
+  }
+
+  // Writes with the given number of threads and restores the previous one
+  template<typename Write>
+  std::string write_with_threads(const int n_threads, Write write) {
+    const int max_threads = omp_get_max_threads();
+    omp_set_num_threads(n_threads);
+    const std::string content = write();
+    omp_set_num_threads(max_threads);
+    return content;
+  }
+
+}
+
+TEST(AsciiWriter, ParallelRangesMatchSerial) {
+  const std::string filename = ::testing::TempDir() + "ascii_writer_ranges.txt";
+  const std::string expected = write_with_threads(1, [&]() { return write_ranges(filename); });
+  ASSERT_FALSE(expected.empty());
+  for(const int n_threads : {2, 4, 7}) {
+    EXPECT_TRUE(expected == write_with_threads(n_threads, [&]() {
+          return write_ranges(filename);
+        })) << n_threads << " threads";
+  }
+}
+
+// Matrices are formatted by dimension, each one through write_range
+TEST(AsciiWriter, ParallelMatricesMatchSerial) {
+  // The middle dimensions hold more columns than a chunk
+  const BoundaryMatrix<VectorColumn> boundary_matrix = simplex_boundary(17);
+  std::vector<dimension_t> dimensions;
+  for(index_t idx = 0; idx < boundary_matrix.get_n_columns(); ++idx)
+    dimensions.push_back(boundary_matrix.get_dimension(idx));
+  const ViewMatrix<VectorColumn> view_matrix(boundary_matrix, dimensions);
+
+  const std::string prefix = ::testing::TempDir() + "ascii_writer";
+  for(const std::string name : {"boundary", "view"}) {
+    auto save = [&]() {
+      EXPECT_TRUE(name == "boundary" ? boundary_matrix.save_ascii(name, prefix)
+                                     : view_matrix.save_ascii(name, prefix));
+      const std::string filename = prefix + "_" + name + ".dat";
+      const std::string content = read_file(filename);
+      std::remove(filename.c_str());
+      return content;
+    };
+
+    const std::string expected = write_with_threads(1, save);
+    ASSERT_FALSE(expected.empty());
+    EXPECT_TRUE(expected == write_with_threads(4, save)) << name;
+  }
+}
@@ -0,0 +1,221 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <steenroder/boundary_matrix.hpp>
+#include <steenroder/mapped_matrix.hpp>
+#include <steenroder/sorted_matrix.hpp>
+#include <steenroder/vector_column.hpp>
+
+#include "simplex_boundary.hpp"
+
+using namespace stn;
+
+namespace {
+
+  std::string temp_filename(const std::string& name) {
+    return ::testing::TempDir() + "binary_format_" + name;
+  }
+
+  BoundaryMatrix<VectorColumn> load_example(const std::string& name) {
+    BoundaryMatrix<VectorColumn> matrix;
+    EXPECT_TRUE(matrix.load_ascii(std::string(STN_EXAMPLES_DIR) + "/" + name));
+    return matrix;
+  }
+
+  // Writes the legacy layout, of which there is no writer any more
+  void save_legacy(const std::string& filename, const BoundaryMatrix<VectorColumn>& matrix) {
+    std::ofstream output_stream(filename.c_str(), std::ios_base::binary | std::ios_base::out);
+    std::vector<int64_t> values(1, matrix.get_n_columns());
+    for(index_t idx = 0; idx < matrix.get_n_columns(); ++idx) {
+      const ColumnSpan<index_t> col = matrix.get_span(idx);
+      values.push_back(matrix.get_dimension(idx));
+      values.push_back(col.size());
+      values.insert(values.end(), col.begin(), col.end());
+    }
+    output_stream.write((const char*) values.data(), values.size() * sizeof(int64_t));
+  }
+
+  void expect_round_trip(const BoundaryMatrix<VectorColumn>& matrix) {
+    const std::string prefix = temp_filename("round_trip");
+
+    ASSERT_TRUE(matrix.save_ascii("ascii", prefix));
+    BoundaryMatrix<VectorColumn> from_ascii;
+    ASSERT_TRUE(from_ascii.load_ascii(prefix + "_ascii.dat"));
+    EXPECT_TRUE(from_ascii == matrix);
+
+    ASSERT_TRUE(matrix.save_binary("csr", prefix));
+    EXPECT_TRUE(is_csr_file(prefix + "_csr.dat"));
+    BoundaryMatrix<VectorColumn> from_csr;
+    ASSERT_TRUE(from_csr.load_binary(prefix + "_csr.dat"));
+    EXPECT_TRUE(from_csr == matrix);
+
+    ASSERT_TRUE(matrix.save_compressed(prefix + "_compressed.dat"));
+    MappedFile compressed_file;
+    ASSERT_TRUE(compressed_file.open(prefix + "_compressed.dat", false));
+    EXPECT_TRUE(is_compressed_file(compressed_file));
+    BoundaryMatrix<VectorColumn> from_compressed;
+    ASSERT_TRUE(from_compressed.load_binary(prefix + "_compressed.dat"));
+    EXPECT_TRUE(from_compressed == matrix);
+
+    save_legacy(prefix + "_legacy.dat", matrix);
+    BoundaryMatrix<VectorColumn> from_legacy;
+    ASSERT_TRUE(from_legacy.load_binary(prefix + "_legacy.dat"));
+    EXPECT_TRUE(from_legacy == matrix);
+
+    for(const char* suffix : {"_ascii.dat", "_csr.dat", "_compressed.dat", "_legacy.dat"})
+      std::remove((prefix + suffix).c_str());
+  }
+
+  // Columns out of [min_dim, max_dim] must be left empty, all attributes read
+  void expect_range(const std::string& filename, const BoundaryMatrix<VectorColumn>& matrix,
+                    const int64_t min_dim, const int64_t max_dim) {
+    std::vector<VectorColumn> columns;
+    std::vector<dimension_t> dimensions;
+    ASSERT_TRUE(load_binary_columns(filename, columns, dimensions, min_dim, max_dim));
+    ASSERT_EQ(matrix.get_n_columns(), (index_t) columns.size());
+    for(index_t idx = 0; idx < matrix.get_n_columns(); ++idx) {
+      EXPECT_EQ(matrix.get_dimension(idx), dimensions[idx]);
+      if(dimensions[idx] >= min_dim && dimensions[idx] <= max_dim)
+        EXPECT_TRUE(matrix.get_span(idx).equals(columns[idx])) << "column " << idx;
+      else
+        EXPECT_TRUE(columns[idx].empty()) << "column " << idx;
+    }
+  }
+
+  template<typename MatrixType>
+  void expect_same_view_matrix(const ViewMatrix<VectorColumn>& expected,
+                               const MatrixType& matrix) {
+    ASSERT_EQ(expected.get_n_columns(), matrix.get_n_columns());
+    ASSERT_EQ(expected.get_n_dimensions(), matrix.get_n_dimensions());
+    for(dimension_t dim = 0; dim < expected.get_n_dimensions(); ++dim) {
+      EXPECT_EQ(expected.get_start_dimension(dim), matrix.get_start_dimension(dim));
+      EXPECT_EQ(expected.get_n_columns_per_dimension(dim),
+                matrix.get_n_columns_per_dimension(dim));
+    }
+    for(index_t idx = 0; idx < expected.get_n_columns(); ++idx) {
+      EXPECT_EQ(expected.get_view(idx), matrix.get_view(idx));
+      EXPECT_TRUE(expected.get_span(idx).equals(matrix.get_span(idx))) << "column " << idx;
+    }
+  }
+
+  // Writes matrix in every binary layout, returning the filenames
+  std::vector<std::string> save_all_layouts(const BoundaryMatrix<VectorColumn>& matrix,
+                                            const std::string& prefix) {
+    save_legacy(prefix + "_legacy.dat", matrix);
+    EXPECT_TRUE(matrix.save_binary("csr", prefix));
+    EXPECT_TRUE(matrix.save_compressed(prefix + "_compressed.dat"));
+    return {prefix + "_legacy.dat", prefix + "_csr.dat", prefix + "_compressed.dat"};
+  }
+
+}
+
+TEST(BinaryFormat, RoundTripsExamples) {
+  for(const char* name : {"rp4.phat", "cone_rp4.phat"})
+    expect_round_trip(load_example(name));
+}
+
+TEST(BinaryFormat, RoundTripsSeveralIndexBlocks) {
+  const BoundaryMatrix<VectorColumn> matrix = simplex_boundary(14);
+  ASSERT_GT(matrix.get_n_columns(), 2 * dimension_block_size);
+  expect_round_trip(matrix);
+}
+
+TEST(BinaryFormat, LoadsDimensionRanges) {
+  const BoundaryMatrix<VectorColumn> matrix = simplex_boundary(14);
+  for(const std::string& filename : save_all_layouts(matrix, temp_filename("range"))) {
+    expect_range(filename, matrix, 0, 0);
+    expect_range(filename, matrix, 3, 5);
+    expect_range(filename, matrix, 13, 13);
+    expect_range(filename, matrix, 14, 20);
+    std::remove(filename.c_str());
+  }
+}
+
+TEST(BinaryFormat, RejectsTruncatedFiles) {
+  const BoundaryMatrix<VectorColumn> matrix = load_example("rp4.phat");
+  for(const std::string& filename : save_all_layouts(matrix, temp_filename("truncated"))) {
+    std::ifstream input_stream(filename.c_str(), std::ios_base::binary);
+    std::string content((std::istreambuf_iterator<char>(input_stream)),
+                        std::istreambuf_iterator<char>());
+    input_stream.close();
+    std::ofstream output_stream(filename.c_str(),
+                                std::ios_base::binary | std::ios_base::trunc);
+    output_stream.write(content.data(), content.size() / 2);
+    output_stream.close();
+
+    BoundaryMatrix<VectorColumn> truncated;
+    EXPECT_FALSE(truncated.load_binary(filename)) << filename;
+    ViewMatrix<VectorColumn> primal_matrix, dual_matrix;
+    EXPECT_FALSE(primal_matrix.load_binary(filename, dual_matrix)) << filename;
+    MappedViewMatrix<VectorColumn> mapped;
+    EXPECT_FALSE(mapped.load_binary(filename)) << filename;
+    std::remove(filename.c_str());
+  }
+}
+
+// The fused load must fill both matrices as the two separate loaders do
+TEST(BinaryFormat, LoadsWithDual) {
+  for(const char* name : {"rp4.phat", "cone_rp4.phat"}) {
+    for(const std::string& filename
+          : save_all_layouts(load_example(name), temp_filename("with_dual"))) {
+      ViewMatrix<VectorColumn> expected_primal, expected_dual;
+      ASSERT_TRUE(expected_primal.load_binary(filename));
+      ASSERT_TRUE(expected_dual.load_binary_dual(filename));
+
+      ViewMatrix<VectorColumn> primal_matrix, dual_matrix;
+      ASSERT_TRUE(primal_matrix.load_binary(filename, dual_matrix));
+      expect_same_view_matrix(expected_primal, primal_matrix);
+      expect_same_view_matrix(expected_dual, dual_matrix);
+
+      ViewMatrix<VectorColumn> expected_range, range_matrix, range_dual;
+      ASSERT_TRUE(expected_range.load_binary(filename, 0, 2));
+      ASSERT_TRUE(range_matrix.load_binary(filename, range_dual, 0, 2));
+      expect_same_view_matrix(expected_range, range_matrix);
+      expect_same_view_matrix(expected_dual, range_dual);
+
+      // Only the dual columns of dimension 0 to 2 are filled, as from the ascii file
+      ViewMatrix<VectorColumn> expected_range_dual, ascii_primal, ascii_dual;
+      ViewMatrix<VectorColumn> both_range_matrix, both_range_dual;
+      ParseStatistics stats;
+      ASSERT_TRUE(ascii_primal.load_ascii(std::string(STN_EXAMPLES_DIR) + "/" + name,
+                                          ascii_dual, 0, 2, stats));
+      ASSERT_TRUE(expected_range_dual.load_binary_dual(filename, 0, 2));
+      ASSERT_TRUE(both_range_matrix.load_binary(filename, both_range_dual, 0, 2, 0, 2));
+      expect_same_view_matrix(ascii_dual, expected_range_dual);
+      expect_same_view_matrix(expected_range, both_range_matrix);
+      expect_same_view_matrix(expected_range_dual, both_range_dual);
+      std::remove(filename.c_str());
+    }
+  }
+}
+
+// The mapped matrix must read CSR files as the loaded one, and no other
+TEST(BinaryFormat, MapsCsrFiles) {
+  std::vector<BoundaryMatrix<VectorColumn>> matrices = {load_example("rp4.phat"),
+                                                        load_example("cone_rp4.phat"),
+                                                        simplex_boundary(14)};
+  for(const BoundaryMatrix<VectorColumn>& matrix : matrices) {
+    const std::vector<std::string> filenames = save_all_layouts(matrix, temp_filename("mapped"));
+    ViewMatrix<VectorColumn> expected;
+    ASSERT_TRUE(expected.load_binary(filenames[1]));
+    MappedViewMatrix<VectorColumn> mapped;
+    ASSERT_TRUE(mapped.load_binary(filenames[1]));
+    expect_same_view_matrix(expected, mapped);
+    EXPECT_EQ(expected.get_n_entries(), mapped.get_n_entries());
+
+    MappedViewMatrix<VectorColumn> not_csr;
+    EXPECT_FALSE(not_csr.load_binary(filenames[0]));
+    EXPECT_FALSE(not_csr.load_binary(filenames[2]));
+    for(const std::string& filename : filenames)
+      std::remove(filename.c_str());
+  }
+}
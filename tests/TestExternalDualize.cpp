@@ -0,0 +1,97 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <steenroder/boundary_matrix.hpp>
+#include <steenroder/external_dualize.hpp>
+#include <steenroder/vector_column.hpp>
+
+#include "simplex_boundary.hpp"
+
+using namespace stn;
+
+namespace {
+
+  std::string read_file(const std::string& filename) {
+    std::ifstream input_stream(filename.c_str(), std::ios_base::binary);
+    return std::string((std::istreambuf_iterator<char>(input_stream)),
+                       std::istreambuf_iterator<char>());
+  }
+
+  // The external dualize must write the same file as the in-memory one,
+  // whether the budget holds all entries, those of a few buckets of bins or
+  // only those of one bin of rows
+  void expect_same_dualize(BoundaryMatrix<VectorColumn> matrix, const std::string& name,
+                           const bool use_binary) {
+    const std::string prefix = ::testing::TempDir() + "external_dualize_" + name;
+    ASSERT_TRUE(use_binary ? matrix.save_binary("input", prefix)
+                           : matrix.save_ascii("input", prefix));
+    matrix.dualize();
+    ASSERT_TRUE(use_binary ? matrix.save_binary("dualized", prefix)
+                           : matrix.save_ascii("dualized", prefix));
+    const std::string expected = read_file(prefix + "_dualized.dat");
+    ASSERT_FALSE(expected.empty());
+
+    for(const size_t memory_budget : {(size_t) 1 << 30, (size_t) 1 << 16, (size_t) 256}) {
+      ExternalDualizer dualizer(memory_budget, prefix + "_run_");
+      ASSERT_TRUE(dualizer.dualize(prefix + "_input.dat", prefix + "_external.dat",
+                                   use_binary));
+      EXPECT_TRUE(expected == read_file(prefix + "_external.dat"))
+        << name << " with a budget of " << memory_budget << " bytes";
+      std::remove((prefix + "_external.dat").c_str());
+    }
+
+    std::remove((prefix + "_input.dat").c_str());
+    std::remove((prefix + "_dualized.dat").c_str());
+  }
+
+  BoundaryMatrix<VectorColumn> load_example(const std::string& name) {
+    BoundaryMatrix<VectorColumn> matrix;
+    EXPECT_TRUE(matrix.load_ascii(std::string(STN_EXAMPLES_DIR) + "/" + name));
+    return matrix;
+  }
+
+}
+
+TEST(ExternalDualize, MatchesInMemoryAscii) {
+  for(const char* name : {"rp4.phat", "cone_rp4.phat"})
+    expect_same_dualize(load_example(name), name, false);
+  expect_same_dualize(simplex_boundary(12), "simplex", false);
+}
+
+TEST(ExternalDualize, MatchesInMemoryBinary) {
+  for(const char* name : {"rp4.phat", "cone_rp4.phat"})
+    expect_same_dualize(load_example(name), name, true);
+  expect_same_dualize(simplex_boundary(12), "simplex", true);
+}
+
+// Rows are bucketed by bins of 1024, so a small budget splits the full
+// simplex into several buckets. The buffers of all buckets do not fit in
+// such a budget, so they are filled over several passes.
+TEST(ExternalDualize, SplitsIntoBuckets) {
+  const std::string prefix = ::testing::TempDir() + "external_dualize_buckets";
+  ASSERT_TRUE(simplex_boundary(12).save_binary("input", prefix));
+  ExternalDualizer dualizer(256, prefix + "_run_");
+  ASSERT_TRUE(dualizer.dualize(prefix + "_input.dat", prefix + "_external.dat", true));
+  EXPECT_GT(dualizer.get_n_buckets_used(), 1);
+  EXPECT_EQ(dualizer.get_n_buckets_used(), dualizer.get_n_passes_used());
+
+  ExternalDualizer large_dualizer(1 << 30, prefix + "_run_");
+  ASSERT_TRUE(large_dualizer.dualize(prefix + "_input.dat", prefix + "_external.dat", true));
+  EXPECT_EQ(1, large_dualizer.get_n_passes_used());
+  std::remove((prefix + "_input.dat").c_str());
+  std::remove((prefix + "_external.dat").c_str());
+}
+
+TEST(ExternalDualize, RejectsMissingInput) {
+  ExternalDualizer dualizer(1 << 20, ::testing::TempDir() + "external_dualize_missing_run_");
+  EXPECT_FALSE(dualizer.dualize(::testing::TempDir() + "external_dualize_missing.phat",
+                                ::testing::TempDir() + "external_dualize_missing.dat", false));
+}
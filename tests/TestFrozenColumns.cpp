@@ -0,0 +1,129 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <steenroder/frozen_columns.hpp>
+#include <steenroder/sorted_matrix.hpp>
+#include <steenroder/sorted_bars.hpp>
+#include <steenroder/homology.hpp>
+#include <steenroder/small_column.hpp>
+
+using namespace stn;
+
+namespace {
+
+  // Columns with runs of consecutive rows, gaps of every width up to the
+  // largest row, and empty and single row columns in between
+  template<typename IndexType>
+  std::vector<std::vector<IndexType>> make_columns(const int64_t max_row) {
+    std::mt19937_64 generator(0);
+    std::vector<std::vector<IndexType>> columns;
+    columns.push_back({});
+    columns.push_back({0});
+    columns.push_back({(IndexType) max_row});
+    columns.push_back({0, (IndexType) max_row});
+
+    std::vector<IndexType> run;
+    for(IndexType row = 100; row < 300; ++row)
+      run.push_back(row);
+    columns.push_back(run);
+    columns.push_back({});
+
+    for(int max_width = 1; max_width <= 63 && ((int64_t) 1 << (max_width - 1)) < max_row;
+        ++max_width) {
+      const int64_t max_gap = std::min<int64_t>(max_row / 64, ((int64_t) 1 << max_width) - 1);
+      std::uniform_int_distribution<int64_t> gap_distribution(1, std::max<int64_t>(1, max_gap));
+      std::vector<IndexType> col;
+      for(int64_t row = gap_distribution(generator) - 1; row <= max_row && col.size() < 500;
+          row += gap_distribution(generator))
+        col.push_back((IndexType) row);
+      columns.push_back(col);
+    }
+    return columns;
+  }
+
+  template<typename IndexType>
+  void expect_round_trip(const int64_t max_row) {
+    const std::vector<std::vector<IndexType>> columns = make_columns<IndexType>(max_row);
+    FrozenColumns<IndexType> frozen;
+    for(const std::vector<IndexType>& col : columns)
+      frozen.append(col);
+
+    ASSERT_EQ((index_t) columns.size(), frozen.get_n_columns());
+    std::vector<IndexType> decoded;
+    for(index_t idx = 0; idx < frozen.get_n_columns(); ++idx) {
+      frozen.get_column(idx, decoded);
+      EXPECT_EQ(columns[idx], decoded) << "column " << idx;
+      EXPECT_TRUE(frozen.get_span(idx).equals(columns[idx])) << "column " << idx;
+      EXPECT_EQ(columns[idx].empty(), frozen.is_empty(idx));
+      EXPECT_EQ(columns[idx].empty() ? -1 : (index_t) columns[idx].back(),
+                frozen.get_max_index(idx));
+    }
+  }
+
+}
+
+TEST(FrozenColumns, RoundTrips32BitRows) {
+  expect_round_trip<int32_t>(std::numeric_limits<int32_t>::max());
+}
+
+TEST(FrozenColumns, RoundTrips64BitRows) {
+  expect_round_trip<int64_t>((int64_t) 1 << 50);
+}
+
+TEST(FrozenColumns, ClearsColumns) {
+  const std::vector<std::vector<index_t>> columns = make_columns<index_t>(1 << 20);
+  FrozenColumns<index_t> frozen;
+  for(const std::vector<index_t>& col : columns)
+    frozen.append(col);
+
+  for(index_t idx = 0; idx < frozen.get_n_columns(); idx += 2)
+    frozen.clear(idx);
+  for(index_t idx = 0; idx < frozen.get_n_columns(); ++idx) {
+    if(idx % 2 == 0) {
+      EXPECT_TRUE(frozen.is_empty(idx));
+      EXPECT_EQ(-1, frozen.get_max_index(idx));
+      EXPECT_EQ(0, (index_t) frozen.get_span(idx).size());
+    } else {
+      EXPECT_TRUE(frozen.get_span(idx).equals(columns[idx])) << "column " << idx;
+    }
+  }
+}
+
+// Freezing the reduced bars must not change any of their columns
+TEST(FrozenColumns, FreezesBars) {
+  for(const char* name : {"rp4.phat", "cone_rp4.phat"}) {
+    ViewMatrix<SmallColumn32> primal_matrix, dual_matrix;
+    ParseStatistics stats;
+    ASSERT_TRUE(primal_matrix.load_ascii(std::string(STN_EXAMPLES_DIR) + "/" + name,
+                                         dual_matrix, stats));
+    const index_t n_columns = dual_matrix.get_n_columns();
+    const dimension_t n_dimensions = dual_matrix.get_n_dimensions();
+    ViewFiniteBars<SmallColumn32> finite_bars(std::move(dual_matrix));
+    ViewInfiniteBars<SmallColumn32> infinite_bars(n_columns, n_dimensions);
+    Homology<TwistReduction<SmallColumn32>> homology;
+    homology.compute(finite_bars, infinite_bars);
+
+    const ViewFiniteBars<SmallColumn32> finite_copy = finite_bars;
+    const ViewInfiniteBars<SmallColumn32> infinite_copy = infinite_bars;
+    finite_bars.freeze();
+    infinite_bars.freeze();
+
+    ASSERT_EQ(n_columns, finite_bars.get_n_columns());
+    ASSERT_EQ(n_columns, infinite_bars.get_n_columns());
+    for(index_t idx = 0; idx < n_columns; ++idx) {
+      EXPECT_TRUE(finite_bars.get_span(idx).equals(finite_copy.get_span(idx)));
+      EXPECT_TRUE(infinite_bars.get_span(idx).equals(infinite_copy.get_span(idx)));
+      EXPECT_EQ(finite_copy.get_max_index(idx), finite_bars.get_max_index(idx));
+      EXPECT_EQ(infinite_copy.is_empty(idx), infinite_bars.is_empty(idx));
+    }
+  }
+}
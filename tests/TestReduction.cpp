@@ -0,0 +1,219 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+#include <steenroder/boundary_matrix.hpp>
+#include <steenroder/sorted_matrix.hpp>
+#include <steenroder/sorted_bars.hpp>
+#include <steenroder/homology.hpp>
+#include <steenroder/reduction.hpp>
+#include <steenroder/vector_column.hpp>
+#include <steenroder/small_column.hpp>
+#include <steenroder/arena_matrix.hpp>
+#include <steenroder/sparse_column.hpp>
+#include <steenroder/bit_tree_column.hpp>
+#include <steenroder/heap_column.hpp>
+#include <steenroder/full_column.hpp>
+#include <steenroder/hybrid_column.hpp>
+
+using namespace stn;
+
+namespace {
+
+  const char* const examples[] = {"rp4.phat", "cone_rp4.phat"};
+
+  template<typename ColumnType>
+  bool load_dual(const std::string& name, ViewMatrix<ColumnType>& dual_matrix) {
+    ViewMatrix<ColumnType> primal_matrix;
+    ParseStatistics stats;
+    return primal_matrix.load_ascii(std::string(STN_EXAMPLES_DIR) + "/" + name,
+                                    dual_matrix, stats);
+  }
+
+  // Bars of the reference reduction, and their pivots
+  struct Pairs {
+    std::vector<index_t> pivots;
+    std::vector<index_t> finite_views, births, deaths;
+    std::vector<index_t> infinite_views, infinite_births;
+    std::vector<index_t> n_finite_per_dimension, n_infinite_per_dimension;
+
+    bool operator==(const Pairs& other) const {
+      return pivots == other.pivots && finite_views == other.finite_views
+        && births == other.births && deaths == other.deaths
+        && infinite_views == other.infinite_views
+        && infinite_births == other.infinite_births
+        && n_finite_per_dimension == other.n_finite_per_dimension
+        && n_infinite_per_dimension == other.n_infinite_per_dimension;
+    }
+  };
+
+  template<typename ColumnType>
+  Pairs get_pairs(const ViewFiniteBars<ColumnType>& finite_bars,
+                  const ViewInfiniteBars<ColumnType>& infinite_bars) {
+    Pairs pairs;
+    for(index_t idx = 0; idx < finite_bars.get_n_columns(); ++idx) {
+      pairs.pivots.push_back(finite_bars.get_max_index(idx));
+      pairs.finite_views.push_back(finite_bars.get_view(idx));
+      pairs.births.push_back(finite_bars.get_birth(idx));
+      pairs.deaths.push_back(finite_bars.get_death(idx));
+      pairs.infinite_views.push_back(infinite_bars.get_view(idx));
+      pairs.infinite_births.push_back(infinite_bars.get_birth(idx));
+    }
+    for(dimension_t dim = 0; dim < finite_bars.get_n_dimensions(); ++dim) {
+      pairs.n_finite_per_dimension.push_back(finite_bars.get_n_columns_per_dimension(dim));
+      pairs.n_infinite_per_dimension.push_back(infinite_bars.get_n_columns_per_dimension(dim));
+    }
+    return pairs;
+  }
+
+  template<typename Reduction, typename ColumnType>
+  Pairs compute_pairs(const std::string& name) {
+    ViewMatrix<ColumnType> dual_matrix;
+    EXPECT_TRUE(load_dual(name, dual_matrix));
+    const index_t n_columns = dual_matrix.get_n_columns();
+    ViewInfiniteBars<ColumnType> infinite_bars(n_columns, dual_matrix.get_n_dimensions());
+    ViewFiniteBars<ColumnType> finite_bars(std::move(dual_matrix));
+    Homology<Reduction> homology;
+    homology.compute(finite_bars, infinite_bars);
+    return get_pairs(finite_bars, infinite_bars);
+  }
+
+  // The standard reduction works on the unsorted matrix, so only the pivots
+  // of its reduced columns can be compared
+  template<typename Reduction, typename ColumnType>
+  std::vector<index_t> compute_pivots(const std::string& name) {
+    ViewMatrix<ColumnType> dual_matrix;
+    EXPECT_TRUE(load_dual(name, dual_matrix));
+    const index_t n_columns = dual_matrix.get_n_columns();
+    BoundaryMatrix<ColumnType> boundary_matrix, triangular_matrix;
+    boundary_matrix.set_n_columns(n_columns);
+    ColumnType col;
+    for(index_t idx = 0; idx < n_columns; ++idx) {
+      dual_matrix.get_column(idx, col);
+      boundary_matrix.set_column(idx, col);
+      boundary_matrix.set_dimension(idx, dual_matrix.get_dimension(idx));
+    }
+
+    Reduction reduction;
+    reduction(boundary_matrix, triangular_matrix);
+    std::vector<index_t> pivots;
+    for(index_t idx = 0; idx < n_columns; ++idx)
+      pivots.push_back(boundary_matrix.get_max_index(idx));
+    return pivots;
+  }
+
+  // Every reduction must pair the same columns as the twist reduction of
+  // sparse vector columns, whatever the pivot column and column type
+  template<typename ColumnType, typename PivotColumn>
+  void expect_same_pairs() {
+    for(const char* name : examples) {
+      const Pairs expected
+        = compute_pairs<TwistReduction<VectorColumn, SparsePivotColumn<VectorColumn>>,
+                        VectorColumn>(name);
+
+      EXPECT_TRUE(expected == (compute_pairs<TwistReduction<ColumnType, PivotColumn>,
+                                             ColumnType>(name))) << name << " twist";
+
+      const int max_threads = omp_get_max_threads();
+      for(const int n_threads : {1, 4}) {
+        omp_set_num_threads(n_threads);
+        EXPECT_TRUE(expected == (compute_pairs<ChunkReduction<ColumnType, PivotColumn>,
+                                               ColumnType>(name)))
+          << name << " chunk with " << n_threads << " threads";
+      }
+      omp_set_num_threads(max_threads);
+
+      EXPECT_EQ(expected.pivots,
+                (compute_pivots<StandardReduction<ColumnType, PivotColumn>, ColumnType>(name)))
+        << name << " standard";
+    }
+  }
+
+  template<typename ColumnType>
+  void expect_same_pairs_all_pivot_columns() {
+    expect_same_pairs<ColumnType, SparsePivotColumn<ColumnType>>();
+    expect_same_pairs<ColumnType, BitTreePivotColumn>();
+    expect_same_pairs<ColumnType, HeapPivotColumn>();
+    expect_same_pairs<ColumnType, FullPivotColumn>();
+    expect_same_pairs<ColumnType, HybridPivotColumn<ColumnType>>();
+  }
+
+}
+
+TEST(Reduction, SamePairsVectorColumn) {
+  expect_same_pairs_all_pivot_columns<VectorColumn>();
+}
+
+TEST(Reduction, SamePairsVectorColumn32) {
+  expect_same_pairs_all_pivot_columns<VectorColumn32>();
+}
+
+TEST(Reduction, SamePairsSmallColumn) {
+  expect_same_pairs_all_pivot_columns<SmallColumn>();
+}
+
+TEST(Reduction, SamePairsSmallColumn32) {
+  expect_same_pairs_all_pivot_columns<SmallColumn32>();
+}
+
+TEST(Reduction, SamePairsArenaColumn) {
+  expect_same_pairs_all_pivot_columns<ArenaColumn>();
+}
+
+// The reductions of the dimension blocks must match the twist reduction of
+// the view, whether the blocks copy its columns or take them over
+template<typename ColumnType>
+void expect_same_pairs_matrix_vector() {
+  for(const char* name : examples) {
+    const Pairs expected = compute_pairs<TwistReduction<VectorColumn>, VectorColumn>(name);
+
+    for(const bool move_columns : {false, true}) {
+      for(const int n_threads : {0, 1, 4}) {
+        ViewMatrix<ColumnType> dual_matrix;
+        ASSERT_TRUE(load_dual(name, dual_matrix));
+        const index_t n_columns = dual_matrix.get_n_columns();
+        ViewInfiniteBars<ColumnType> infinite_bars(n_columns, dual_matrix.get_n_dimensions());
+        ViewFiniteBars<ColumnType> finite_bars(std::move(dual_matrix));
+        MatrixVector<ColumnType> finite_blocks = move_columns
+          ? MatrixVector<ColumnType>(std::move(finite_bars))
+          : MatrixVector<ColumnType>(finite_bars);
+        if(move_columns) {
+          for(index_t idx = 0; idx < n_columns; ++idx)
+            EXPECT_TRUE(finite_bars.is_empty(idx));
+        }
+
+        // No threads stands for the twist reduction
+        if(n_threads == 0) {
+          Homology<TwistReduction<ColumnType>> homology;
+          homology.compute(finite_blocks, finite_bars, infinite_bars);
+        } else {
+          const int max_threads = omp_get_max_threads();
+          omp_set_num_threads(n_threads);
+          Homology<ChunkReduction<ColumnType>> homology;
+          homology.compute(finite_blocks, finite_bars, infinite_bars);
+          omp_set_num_threads(max_threads);
+        }
+        EXPECT_TRUE(expected == get_pairs(finite_bars, infinite_bars))
+          << name << (move_columns ? " moved" : " copied") << " with "
+          << n_threads << " threads";
+      }
+    }
+  }
+}
+
+TEST(Reduction, SamePairsMatrixVector) {
+  expect_same_pairs_matrix_vector<VectorColumn>();
+}
+
+TEST(Reduction, SamePairsMatrixVectorSmallColumn) {
+  expect_same_pairs_matrix_vector<SmallColumn>();
+}
+
+TEST(Reduction, SamePairsMatrixVectorArenaColumn) {
+  expect_same_pairs_matrix_vector<ArenaColumn>();
+}
@@ -0,0 +1,120 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <steenroder/representative_writer.hpp>
+#include <steenroder/vector_column.hpp>
+
+using namespace stn;
+
+namespace {
+
+  struct Bar {
+    dimension_t dim;
+    index_t birth, death;
+    std::vector<int64_t> rows;
+  };
+
+  // Empty representatives in the middle and at both ends, deaths that are
+  // only known once later bars are written
+  std::vector<Bar> make_bars() {
+    std::vector<Bar> bars;
+    bars.push_back({0, 0, -1, {}});
+    for(index_t idx = 1; idx < 40; ++idx) {
+      Bar bar = {(dimension_t) (idx % 3), 2 * idx, idx % 4 == 0 ? -1 : 3 * idx, {}};
+      if(idx % 5 != 0) {
+        for(int64_t row = idx; row < 10 * idx; row += idx % 7 + 1)
+          bar.rows.push_back(row);
+      }
+      bars.push_back(bar);
+    }
+    bars.push_back({2, 100, 200, {((int64_t) 1 << 40) - 1, (int64_t) 1 << 40}});
+    bars.push_back({1, 101, -1, {}});
+    return bars;
+  }
+
+  template<typename ColumnType>
+  void write_bars(const std::string& filename, const std::vector<Bar>& bars) {
+    RepresentativeWriter writer;
+    ASSERT_TRUE(writer.open(filename));
+    ASSERT_TRUE(writer.is_open());
+    for(index_t idx = 0; idx < (index_t) bars.size(); ++idx) {
+      ColumnType col(bars[idx].rows.begin(), bars[idx].rows.end());
+      EXPECT_EQ(idx, writer.write(bars[idx].dim, bars[idx].birth, -1, col));
+    }
+    for(index_t idx = 0; idx < (index_t) bars.size(); ++idx)
+      writer.set_death(idx, bars[idx].death);
+    ASSERT_TRUE(writer.close());
+  }
+
+  void expect_bar(const RepresentativeReader& reader, const std::vector<Bar>& bars,
+                  const index_t idx) {
+    EXPECT_EQ(bars[idx].dim, reader.get_dimension(idx)) << "bar " << idx;
+    EXPECT_EQ(bars[idx].birth, reader.get_birth(idx)) << "bar " << idx;
+    EXPECT_EQ(bars[idx].death, reader.get_death(idx)) << "bar " << idx;
+    EXPECT_TRUE(reader.get_span(idx).equals(bars[idx].rows)) << "bar " << idx;
+    std::vector<int64_t> col(1, -1);
+    reader.get_column(idx, col);
+    EXPECT_EQ(bars[idx].rows, col) << "bar " << idx;
+  }
+
+  // Bars are read back in any order, starting from the middle of the file
+  template<typename ColumnType>
+  void expect_round_trip(const std::string& name, const std::vector<Bar>& bars) {
+    const std::string filename = ::testing::TempDir() + "representatives_" + name + ".dat";
+    write_bars<ColumnType>(filename, bars);
+
+    RepresentativeReader reader;
+    ASSERT_TRUE(reader.open(filename));
+    ASSERT_EQ((index_t) bars.size(), reader.get_n_bars());
+    if(!bars.empty())
+      expect_bar(reader, bars, (index_t) bars.size() / 2);
+    for(index_t idx = (index_t) bars.size() - 1; idx >= 0; --idx)
+      expect_bar(reader, bars, idx);
+    std::remove(filename.c_str());
+  }
+
+}
+
+TEST(Representatives, RoundTrips64BitRows) {
+  expect_round_trip<VectorColumn>("64", make_bars());
+}
+
+// Narrower rows are widened to int64_t when written
+TEST(Representatives, RoundTrips32BitRows) {
+  std::vector<Bar> bars = make_bars();
+  bars.erase(bars.end() - 2);
+  expect_round_trip<VectorColumn32>("32", bars);
+}
+
+TEST(Representatives, RoundTripsNoBars) {
+  expect_round_trip<VectorColumn>("empty", std::vector<Bar>());
+}
+
+TEST(Representatives, RejectsTruncatedFiles) {
+  const std::string filename = ::testing::TempDir() + "representatives_truncated.dat";
+  write_bars<VectorColumn>(filename, make_bars());
+  std::ifstream input_stream(filename.c_str(), std::ios_base::binary);
+  const std::string content((std::istreambuf_iterator<char>(input_stream)),
+                            std::istreambuf_iterator<char>());
+  input_stream.close();
+
+  for(const size_t size : {(size_t) 0, sizeof(RepresentativeHeader) - 1,
+                           sizeof(RepresentativeHeader), content.size() / 2,
+                           content.size() - 1}) {
+    std::ofstream output_stream(filename.c_str(), std::ios_base::binary);
+    output_stream.write(content.data(), size);
+    output_stream.close();
+    RepresentativeReader reader;
+    EXPECT_FALSE(reader.open(filename)) << size << " bytes";
+  }
+  std::remove(filename.c_str());
+}
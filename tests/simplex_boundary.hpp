@@ -0,0 +1,57 @@
+/*  Author: Guillaume Tauzin
+    License: GPLv3
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <steenroder/boundary_matrix.hpp>
+#include <steenroder/vector_column.hpp>
+
+namespace stn {
+
+  // Boundary matrix of the full simplex on n_vertices vertices, its faces
+  // ordered by dimension then lexicographically. Its 2^n_vertices - 1
+  // columns make test complexes of any size.
+  inline BoundaryMatrix<VectorColumn> simplex_boundary(const index_t n_vertices) {
+    std::vector<std::vector<index_t>> faces;
+    for(index_t size = 1; size <= n_vertices; ++size) {
+      std::vector<bool> chosen(n_vertices, false);
+      std::fill(chosen.end() - size, chosen.end(), true);
+      do {
+        std::vector<index_t> face;
+        for(index_t vertex = 0; vertex < n_vertices; ++vertex)
+          if(chosen[vertex])
+            face.push_back(vertex);
+        faces.push_back(face);
+      } while(std::next_permutation(chosen.begin(), chosen.end()));
+    }
+    std::stable_sort(faces.begin(), faces.end(),
+                     [](const std::vector<index_t>& a, const std::vector<index_t>& b) {
+                       return a.size() < b.size();
+                     });
+    std::map<std::vector<index_t>, index_t> face_indices;
+    for(index_t idx = 0; idx < (index_t) faces.size(); ++idx)
+      face_indices[faces[idx]] = idx;
+
+    BoundaryMatrix<VectorColumn> matrix(faces.size());
+    for(index_t idx = 0; idx < (index_t) faces.size(); ++idx) {
+      VectorColumn col;
+      if(faces[idx].size() > 1) {
+        for(index_t removed = 0; removed < (index_t) faces[idx].size(); ++removed) {
+          std::vector<index_t> facet = faces[idx];
+          facet.erase(facet.begin() + removed);
+          col.push_back(face_indices[facet]);
+        }
+        std::sort(col.begin(), col.end());
+      }
+      matrix.set_column(idx, col);
+      matrix.set_dimension(idx, faces[idx].size() - 1);
+    }
+    return matrix;
+  }
+
+} // namespace stn